@@ -0,0 +1,101 @@
+/* File:     life.h
+ * Purpose:  The engines of pth_life.c as a library.  A Life is one
+ *           world with its own engine, rule, buffers and threads, so
+ *           a program can keep any number of them and step them
+ *           from different threads at once (but each Life from one
+ *           thread at a time).
+ *
+ * Compile:  gcc -g -Wall -O2 -fPIC -DLIFE_LIBRARY -fvisibility=hidden
+ *              -shared -o liblife.so pth_life.c -lpthread
+ *           (LIFE_LIBRARY leaves out main, and only the functions
+ *           below are exported)
+ *
+ * Cells:    Whole worlds go in and out as m*n chars, row by row, 1
+ *           for a live cell and 0 for a dead one.
+ */
+#ifndef LIFE_H
+#define LIFE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef LIFE_LIBRARY
+#  define LIFE_API __attribute__((visibility("default")))
+#else
+#  define LIFE_API
+#endif
+
+typedef struct Life Life;
+
+/*---------------------------------------------------------------------
+ * Function:   Life_create
+ * Purpose:    Make an empty m x n toroidal world
+ * In args:    m, n:  size of the world (at least 3 x 3)
+ *             engine:  "dense", "packed", "lut" or "halo"
+ *             rule:  as for --rule, e.g. "B3/S23" or "highlife"
+ *             threads:  number of threads to step it with
+ * Ret val:    The world, at generation 0, or NULL if an argument is
+ *             bad, there's no memory for it or its threads can't be
+ *             started, or (for the lut engine) 16 other rules already
+ *             have tables in live worlds
+ */
+LIFE_API Life* Life_create(int m, int n, const char engine[],
+      const char rule[], int threads);
+
+/*---------------------------------------------------------------------
+ * Function:   Life_load
+ * Purpose:    Replace the world with cells, and make it generation 0
+ * Ret val:    Its population
+ */
+LIFE_API long Life_load(Life* life, const char cells[]);
+
+/*---------------------------------------------------------------------
+ * Function:   Life_random
+ * Purpose:    Replace the world with the random generation 0 that
+ *             pth_life makes for 'g' with --seed=seed, where each
+ *             cell is alive with probability prob
+ * Ret val:    Its population, or -1 (and the world is left as it
+ *             was) if there's no memory for the m*n cells
+ */
+LIFE_API long Life_random(Life* life, uint64_t seed, double prob);
+
+/*---------------------------------------------------------------------
+ * Function:   Life_step
+ * Purpose:    Advance the world k generations
+ * Ret val:    The population of the new generation, or -1 (and the
+ *             world is left as it was) if k < 0
+ */
+LIFE_API long Life_step(Life* life, long k);
+
+LIFE_API long Life_population(const Life* life);
+LIFE_API long Life_generation(const Life* life);
+
+/*---------------------------------------------------------------------
+ * Function:   Life_snapshot
+ * Purpose:    Copy the current generation into cells (m*n chars)
+ */
+LIFE_API void Life_snapshot(const Life* life, char cells[]);
+
+/*---------------------------------------------------------------------
+ * Function:   Life_buffer
+ * Purpose:    Get the engine's own buffer of the current generation,
+ *             without copying it
+ * Out arg:    size_p:  its size in bytes, if it isn't NULL
+ * Ret val:    The buffer, which stays valid until the next
+ *             Life_step, Life_load or Life_random.  The layout is the
+ *             engine's:
+ *                dense:  m*n ints, cell (i,j) at i*n + j
+ *                packed, lut:  m rows of ceil(n/64) uint64_t words,
+ *                   cell (i,j) is bit j%64 of word j/64 of row i
+ *                halo:  (m+2)*(n+2) bytes, cell (i,j) at
+ *                   (i+1)*(n+2) + j+1, inside a ghost border
+ */
+LIFE_API const void* Life_buffer(const Life* life, size_t* size_p);
+
+/*---------------------------------------------------------------------
+ * Function:   Life_destroy
+ * Purpose:    Stop the world's threads and free it
+ */
+LIFE_API void Life_destroy(Life* life);
+
+#endif
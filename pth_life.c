@@ -21,8 +21,13 @@
  *
  *           Updates take place all at once.
  * 
- * Compile:  gcc -g -Wall -o pth_life pth_life.c -lpthread
- * Run:      ./pth_life <r> <c> <m> <n> <max> <'i'|'g'>
+ * Compile:  gcc -g -Wall -O2 -o pth_life pth_life.c -lpthread
+ *           (add -DUSE_NUMA ... -lnuma for --numa; see
+ *           pth_life_gpu.cu for the GPU engines; build with
+ *           mpicc -DUSE_MPI for --mpi, and run with
+ *           mpiexec -n <r*c> ./pth_life ... --mpi; add
+ *           -DLIFE_PROFILE for the per-thread profile and --trace)
+ * Run:      ./pth_life <r> <c> <m> <n> <max> <'i'|'g'|'e'> [options]
  *              r = number of rows of threads
  *              c = number of cols of threads
  *				    m = number of rows in the world 
@@ -31,6 +36,139 @@
  *              'i' = user will enter the initial world (generation 0) on stdin
  *              'g' = the program should use a random number generator to
  *         				generate the initial world.
+ *              'e' = the initial world is empty, except for the
+ *                    --pattern files
+ *           Options:
+ *              --engine=dense   one int per cell (default)
+ *              --engine=packed  one bit per cell, 64 cells per word
+ *              --engine=halo    one byte per cell, with a ghost border
+ *              --engine=lut     one bit per cell, 2x2 squares at a
+ *                               time from a table of their 4x4
+ *                               neighborhoods
+ *              --engine=hashlife
+ *                               Gosper's HashLife, for very long
+ *                               runs (serial; m and n powers of 2)
+ *              --engine=gpu     one byte per cell, on the GPU
+ *              --engine=gpu-packed
+ *                               one bit per cell, on the GPU
+ *                               (both need USE_GPU)
+ *              --hl-nodes=N     let HashLife keep N nodes before it
+ *                               collects garbage
+ *              --engine=sparse  store only the live cells (serial)
+ *              --topology=torus|plane
+ *                               the world is a torus (default), or
+ *                               the m x n window at (0,0) of the
+ *                               infinite plane (hashlife and sparse)
+ *              --kernel=auto|scalar|avx2|avx512|neon|window
+ *                               SIMD kernel for the packed and halo
+ *                               engines (default: widest available),
+ *                               or column sums for dense and halo
+ *              --barrier=mutex|sense|hybrid|dissem
+ *                               barrier between generations (see
+ *                               the barrier functions, default mutex)
+ *              --population     add the number of live cells to the
+ *                               title of each generation
+ *              --decomp=block   thread (i,j) of the r x c thread grid
+ *                               updates block (i,j) of the world
+ *                               (default)
+ *              --decomp=strip   the r*c threads update horizontal
+ *                               strips of the world
+ *              --tiles=TRxTC    cut the world into TR x TC tiles
+ *                               (TR strips for --decomp=strip), and
+ *                               give each thread the tiles in its
+ *                               block or strip
+ *              --sched=static   each thread updates its own tiles
+ *                               (default)
+ *              --sched=steal    a thread that runs out of tiles
+ *                               steals tiles from other threads
+ *              --sched=pipeline no barrier:  a tile moves on to the
+ *                               next generation as soon as its
+ *                               neighbors have caught up
+ *              --halo-depth=k   give each tile a halo k cells deep,
+ *                               and advance it k generations per
+ *                               barrier
+ *              --active         only compute the tiles that changed,
+ *                               or have a neighbor that changed, in
+ *                               the last generation
+ *              --cycles=P       stop when the world repeats with a
+ *                               period of at most P generations (a
+ *                               still life has period 1)
+ *              --batch=file     play a world of m x n 'g' cells for
+ *                               each line "seed density" of file,
+ *                               each by a single thread, and print
+ *                               a CSV table of how each one ended
+ *              --bench=csv|json run every engine and kernel with each
+ *                               of the sizes, densities, barriers and
+ *                               thread grids below, with output off,
+ *                               and print their cell updates per
+ *                               second, times per generation and
+ *                               scaling efficiency
+ *              --bench-engines=engine[:kernel],...
+ *              --bench-sizes=MxN,...
+ *              --bench-densities=p,...
+ *              --bench-threads=RxC,...
+ *              --bench-barriers=name,...
+ *                               (default:  every engine and kernel,
+ *                               m x n, 0.3, 1x1 and r x c, --barrier)
+ *              --view=HxW       stream an H x W pixel picture of the
+ *                               world, each pixel the share of live
+ *                               cells under it, computed by the
+ *                               threads as they go
+ *              --view-window=row,col,RxC
+ *                               show only the R x C cells from
+ *                               (row,col) (default the whole world)
+ *              --view-fps=F     at most F frames a second (default 10)
+ *              --view-out=unix:path|tcp:host:port|shm:name
+ *                               where the frames go:  a monitor's
+ *                               socket, or a shared memory ring
+ *              --trace=file     write a Chrome trace of what each
+ *                               thread did when (needs LIFE_PROFILE)
+ *              --pin            pin each thread to its own core
+ *              --numa           pin, and bind each thread's blocks
+ *                               of the world to its NUMA node
+ *                               (needs USE_NUMA)
+ *              --hugepages      back the worlds with huge pages
+ *                               (worlds of 32 MB or more always are)
+ *              --cache-block=auto|off|W
+ *                               step tiles in column strips of W
+ *                               cells, or time a few widths at the
+ *                               start and take the fastest
+ *              --mpi            run as r*c MPI processes, each of
+ *                               which holds only its own block
+ *                               (needs USE_MPI)
+ *              --pattern=file[@row,col]
+ *                               paste the RLE or plaintext (.cells)
+ *                               pattern in file into generation 0,
+ *                               with its upper left corner at
+ *                               (row,col), or in the middle of the
+ *                               world (may be repeated)
+ *              --format=text|rle|delta
+ *                               print each generation as text
+ *                               (default), as an RLE pattern, or as
+ *                               the cells that changed since the
+ *                               last one printed
+ *              --keyframe=K     with --format=delta, write the whole
+ *                               world every K frames (default 100)
+ *              --index=file     write the generation, kind, offset
+ *                               and size of each frame to file
+ *              --rule=Bxxx/Syyy a Life-like rule:  a dead cell with x
+ *                               live neighbors is born, a live one
+ *                               with y survives (default B3/S23;
+ *                               also life, highlife, daynight)
+ *              --seed=N         seed of the random generation 0
+ *                               (default 1)
+ *              --checkpoint=k   write a binary checkpoint every k
+ *                               generations
+ *              --checkpoint-file=file
+ *                               where to write it (default
+ *                               pth_life.ckpt)
+ *              --packbits       compress the checkpoint
+ *              --restore=file   start from a checkpoint, instead of
+ *                               from generation 0
+ *              --output=all|final|none|k
+ *                               print every generation (default),
+ *                               only the last one, none of them, or
+ *                               every k-th one
  *
  * Input:    If command line has the "input" char ('i'), the first
  *              generation.  Each row should be entered on a separate
@@ -38,22 +176,81 @@
  *              a capital 'X', and dead cells with a blank, ' '.
  *           If command line had the "generate" char ('g'), the
  *              probability that a cell will be alive.
+ *           With 'e' there is no input.  The --pattern files are
+ *              pasted over generation 0, whichever way it's made.
  *
  * Output:   The initial world (generation 0) and the world after
  *           each subsequent generation up to and including
  *           generation = max_gen.  If all of the cells die,
- *           the program will terminate.
+ *           the program will terminate.  The worlds are printed by
+ *           a separate writer thread from copies made at the
+ *           barrier, so the threads computing the next generation
+ *           don't wait for stdout.
  *
  * Notes:
  * 1.  This implementation uses a "toroidal world" in which the
  *     the last row of cells is adjacent to the first row, and
  *     the last column of cells is adjacent to the first.
+ * 2.  The world is stored by an "engine", which owns the layout
+ *     of w1 and w2 and the kernel that computes a block of the
+ *     next generation.  The rest of the program only sees whole
+ *     rows of LIVE/DEAD chars through the engine's store_row and
+ *     load_row functions.  Block columns are counted in engine
+ *     "units":  cells for the dense and halo engines, 64-bit words
+ *     for the packed engine.
+ * 3.  The halo engine surrounds the world with a one cell ghost
+ *     border that holds copies of the opposite edges.  It is
+ *     refreshed by the thread that computes the cells on the edge,
+ *     so the kernel reads all eight neighbors directly, without
+ *     modulo arithmetic.
+ * 4.  The threads are a pool, created once and given a job (a
+ *     whole run) by Pool_run.  With --sched=pipeline there is no
+ *     barrier:  each tile has its own generation counter, and a
+ *     thread advances one of its tiles as soon as the tile's
+ *     eight neighbors have caught up, so tiles can be several
+ *     generations apart.
+ * 5.  Built with -DLIFE_LIBRARY (see life.h), there's no main, and
+ *     the engines are a library:  each Life keeps its own world,
+ *     rule, kernel and pool, and none of the globals of a run.
+ *     The kernels take the rule as an argument for this.
  * 
  */
 
+#define _GNU_SOURCE         /* CPU_SET, pthread_setaffinity_np */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#ifdef USE_NUMA
+#  include <numa.h>
+#endif
+#ifdef USE_MPI
+#  include <mpi.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#  include <arm_neon.h>
+#  ifdef __linux__
+#     include <sys/auxv.h>
+#     include <asm/hwcap.h>
+#  endif
+#endif
+#include "life.h"
 
 #define LIVE 1
 #define DEAD 0 
@@ -61,76 +258,1219 @@
 #define DEAD_IO ' '
 #define MAX_TITLE 1000
 #define BARRIER_COUNT 1000 
+#define CACHE_LINE 64
+#define SPIN_YIELD 1024     /* spins between sched_yields */
+#define HYBRID_SPINS 4096   /* spins before the hybrid barrier parks */
+#define MAX_ROUNDS 32       /* ceil(log2(thread_count)) <= MAX_ROUNDS */
+#define STEAL_TILES 4       /* default tiles per thread, each way, for
+                               the steal and pipeline schedulers */
+#define PIPE_DEPTH 8        /* generations that can be in progress at
+                               once with --sched=pipeline */
+#define HL_BLOCK 4096       /* HashLife nodes allocated at a time */
+#define HL_MAX_NODES (1L << 22)  /* default nodes before collecting */
+#define HL_MAX_LEVEL 64
+#define SP_BIAS 2147483648L /* added to sparse rows and cols */
+#define SP_EMPTY (~(uint64_t) 0)
+#define SP_ALIVE 16         /* flag in the sparse neighbor table */
+#define GPU_BATCH 64        /* most generations per trip to the GPU */
+#define MPI_ROW_TAG 8       /* rows to and from process 0; 0-7 are the
+                               halo directions */
+#define SNAPSHOTS 3         /* worlds queued for the writer thread */
+#define OUTPUT_BUF (1 << 20)
+#define INPUT_BUF (1 << 20)
+#define MAX_PATTERNS 64
+#define RLE_HEADER 256      /* chars of an RLE header line parsed */
+#define CKPT_MAGIC "PTHLIFE"
+#define CKPT_VERSION 2
+#define CKPT_PACKBITS 1     /* flag:  the bands are PackBits coded */
+#define CKPT_BAND 64        /* rows per band of a checkpoint */
+#define MAX_RULE 24         /* chars in a rule's name */
+#define LUT_SIZE 65536      /* 4x4 squares of cells, one per entry */
+#define WINDOW_CELLS 4096   /* widest strip of the window kernels */
+#define MAX_LUTS 16         /* rules the lut engine can have tables for */
+#define LUT_FREE UINT32_MAX /* the rule of an empty slot of luts */
+#define MAX_BENCH 64        /* items in each list of --bench */
+#define VIEW_SLOTS 8        /* frames in a --view-out=shm: ring */
+#define HUGE_MIN (32L << 20) /* worlds this big get huge pages anyway */
+#define TUNE_ROWS 8         /* rows of the band Tune_cache_block times */
+#define TUNE_REPS 3         /* times it steps the band with each strip */
+
+/* Which generations are printed */
+#define OUTPUT_ALL 0
+#define OUTPUT_EVERY 1
+#define OUTPUT_FINAL 2
+#define OUTPUT_NONE 3
+
+/* How the printed generations are written */
+#define FORMAT_TEXT 0       /* the whole world, one char per cell */
+#define FORMAT_RLE 1        /* each one as an RLE pattern */
+#define FORMAT_DELTA 2      /* the cells that changed, with an RLE
+                               key frame every keyframe_every */
+#define RLE_LINE 70         /* longest line of an RLE frame */
+
+/* What a thread's time goes to, with -DLIFE_PROFILE */
+#define PROF_COMPUTE 0      /* updating tiles */
+#define PROF_WAIT 1         /* at the barrier, serial work included */
+#define PROF_SERIAL 2       /* the serial work of a generation */
+#define PROF_OUTPUT 3       /* the writer printing and checkpointing */
+#define PROF_PHASES 4
+#define PROF_EVENTS 4096    /* first size of a thread's --trace events */
+
+#ifdef LIFE_PROFILE
+#  define PROF_START(t0) double t0 = Now()
+#  define PROF_STOP(phase, t0, gen, tile) Prof_add(phase, t0, gen, tile)
+#  define PROF_CELLS(count) if (prof_me != NULL) prof_me->cells += (count)
+#  define PROF_THREAD(k) prof_me = prof != NULL ? &prof[k] : NULL
+#else
+#  define PROF_START(t0)
+#  define PROF_STOP(phase, t0, gen, tile)
+#  define PROF_CELLS(count)
+#  define PROF_THREAD(k)
+#endif
+
+/* Rules:  bit k is birth with k neighbors, bit 9+k survival with k.
+   The common ones get kernels of their own (see RULE_DISPATCH). */
+#define RULE_CONWAY   0x01808   /* B3/S23 */
+#define RULE_HIGHLIFE 0x01848   /* B36/S23 */
+#define RULE_DAYNIGHT 0x3B1C8   /* B3678/S34678 */
+#define RULE_NEXT(r, alive, count) (((r) >> ((count) + 9*(alive))) & 1)
+#define RULE_MASK(r, alive, count) (-(uint64_t) RULE_NEXT(r, alive, count))
+
+/* Computes a block of the next generation under the rule r (see
+ * RULE_NEXT), returns its live count */
+typedef long Update_fn(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r);
+
+/* A world layout together with the kernel that updates it */
+typedef struct {
+   const char* name;
+   int    (*units)(int n);
+   size_t (*world_size)(int m, int n);
+   void   (*store_row)(void* w, int m, int n, int i, const char row[]);
+   void   (*load_row)(const void* w, int m, int n, int i, char row[]);
+   Update_fn* update;                         /* scalar kernel */
+   void   (*refresh)(void* w, int m, int n, int row0, int row1,
+                     int col0, int col1);  /* may be NULL */
+   size_t (*offset)(int m, int n, int i, int col);  /* byte offset of
+                                                     unit col of row i */
+   void   (*run)(void);  /* if not NULL, runs the whole simulation
+                            instead of the threads and update */
+   void   (*copy)(void* dst, const void* src, int m, int n);
+                         /* deep copy, if memcpy won't do */
+   void   (*release)(void* w);  /* free what a world points to */
+   int    plane;         /* can run on the infinite plane */
+   void   (*load_cells)(const void* w, int m, int n, int i, int j,
+                        int len, unsigned char cells[]);
+   void   (*store_cells)(void* w, int m, int n, int i, int j,
+                         int len, const unsigned char cells[]);
+                         /* cells j..j+len-1 of row i, as LIVE/DEAD
+                            bytes; NULL for the serial engines */
+} Engine;
+
+/* A SIMD replacement for an engine's scalar kernel */
+typedef struct {
+   const char* name;
+   const char* engine;
+   int    (*supported)(void);
+   Update_fn* update;
+} Kernel;
+
+/* A barrier:  wait runs serial in exactly one thread, after all the
+ * threads have arrived and before any of them leaves */
+typedef struct {
+   const char* name;
+   void   (*init)(int thread_count);
+   void   (*wait)(long rank, void (*serial)(void));
+   void   (*destroy)(void);
+} Barrier_type;
+
+/* A per-thread int on its own cache line */
+typedef struct {
+   _Alignas(CACHE_LINE) int value;
+} Padded_int;
+
+/* A HashLife quadtree node:  a 2^level x 2^level square of cells */
+typedef struct Hl_node {
+   struct Hl_node *nw, *ne, *sw, *se;  /* quadrants, unused at level 0 */
+   struct Hl_node *next;               /* hash chain, or free list */
+   struct Hl_node *result;             /* memoized Hl_result */
+   uint64_t pop;                       /* live cells */
+   signed char level;
+   signed char result_step;            /* result is 2^result_step gens
+                                          on, -1 if there's none */
+   unsigned char mark;                 /* for the garbage collector */
+} Hl_node;
+
+typedef struct Hl_block {
+   struct Hl_block* next;
+   Hl_node nodes[HL_BLOCK];
+} Hl_block;
+
+/* The live cells of a sparse world, as Sp_keys */
+typedef struct {
+   uint64_t* cells;
+   size_t count, cap;
+   int sorted;
+} Sparse_world;
+
+/* A block of the world:  rows row0..row1-1, units col0..col1-1 */
+typedef struct {
+   int row0, row1;
+   int col0, col1;
+   int ti, tj;       /* position in the grid of tiles */
+} Tile;
+
+/* A copy of a world, waiting for the writer thread */
+typedef struct {
+   void* world;
+   long  gen;
+   long  live;
+   int   print;         /* print it */
+   int   checkpoint;    /* write it to the checkpoint file */
+} Snapshot;
+
+/* The header of a checkpoint file.  It's followed by bands+1 file
+   offsets:  band b, rows b*band_rows .. (b+1)*band_rows - 1, is at
+   offsets[b] .. offsets[b+1] - 1.  A band is its rows of (n+63)/64
+   64-bit words, cell j in bit j % 64 of word j/64, either as they
+   are or PackBits coded.  Everything is in the host's byte order. */
+typedef struct {
+   char     magic[8];   /* CKPT_MAGIC */
+   uint32_t version;
+   uint32_t flags;
+   int64_t  m, n;
+   int64_t  gen, live;
+   char     rule[MAX_RULE];   /* Rule_name, NUL terminated */
+   uint32_t band_rows;
+   uint32_t bands;
+} Ckpt_header;
+
+/* A per-thread long on its own cache line */
+typedef struct {
+   _Alignas(CACHE_LINE) long value;
+} Padded_long;
+
+/* The lut engine's table for a rule (see Lut_hold) */
+typedef struct {
+   atomic_uint rule;       /* LUT_FREE for an empty slot */
+   int   refs;             /* runs and Lifes holding it */
+   unsigned char* table;
+} Lut;
+
+/* A world of a --batch run, and what became of it */
+typedef struct {
+   uint64_t seed;
+   double   prob;       /* probability that a cell of gen 0 is alive */
+   long     live0;      /* population of generation 0 */
+   long     gens;       /* generations computed */
+   long     live;       /* population of the last one */
+   int      period;     /* period found by --cycles, or 0 */
+} Batch_world;
+
+/* When a --bench run reached a generation */
+typedef struct {
+   long     gen;
+   double   time;       /* seconds, from Now */
+} Bench_mark;
+
+/* A configuration of --bench, and how fast it ran */
+typedef struct {
+   const Engine* engine;
+   const char* kernel;  /* NULL for the engines without kernels */
+   const Barrier_type* barrier;  /* NULL for the serial engines */
+   int      m, n, r, s;
+   double   density;
+   int      ok;         /* did the run finish */
+   long     gens;       /* generations computed */
+   double   seconds;
+   double   lat[4];     /* p50, p90, p99 and max seconds per generation */
+} Bench_run;
+
+/* The start of a --view frame:  the header, then height x width
+ * bytes, row by row, each the share of live cells under that pixel
+ * from 0 to 255 */
+typedef struct {
+   char     magic[8];   /* "LIFEVIEW" */
+   uint64_t gen, live;
+   uint32_t height, width;
+   uint32_t row, col, rows, cols;  /* the window of the world shown */
+} View_header;
+
+/* The start of a --view-out=shm: ring, followed by slots frames of
+ * frame_size bytes.  Frame k is in slot k % slots. */
+typedef struct {
+   char     magic[8];   /* "LIFERING" */
+   uint32_t slots, frame_size;
+   _Atomic uint64_t seq;  /* frames written so far */
+} View_ring;
+
+/* A stretch of a thread's time, for --trace */
+typedef struct {
+   double   t0, t1;     /* seconds, from Now */
+   long     gen;        /* the generation it was working on */
+   int      tile;       /* the tile it computed, or -1 */
+   int      phase;      /* PROF_COMPUTE, ... */
+} Prof_event;
+
+/* A thread's counters, with -DLIFE_PROFILE */
+typedef struct {
+   _Alignas(CACHE_LINE) double time[PROF_PHASES];  /* seconds in each */
+   long     cells;      /* cells updated */
+   Prof_event* events;  /* for --trace */
+   long     event_count, event_cap;
+} Prof_thread;
+
+/* A thread's queue of tiles, packed as head << 32 | tail, so that
+ * both ends change with a single compare-and-swap */
+typedef struct {
+   _Alignas(CACHE_LINE) _Atomic uint64_t range;
+} Tile_queue;
+
+/* A tile's generation, on its own cache line */
+typedef struct {
+   _Alignas(CACHE_LINE) _Atomic long value;
+} Tile_clock;
+
+/* A pool of threads that run the same job, once per Pool_run */
+struct Pool;
+typedef struct {
+   struct Pool* pool;
+   long  rank;
+} Pool_member;
+
+typedef struct Pool {
+   int   threads;
+   pthread_t* handles;
+   Pool_member* members;
+   void* (*job)(void* rank);
+   void  (*task)(void* arg, long rank);   /* or this, with arg */
+   void* arg;
+   long  jobs;              /* number of jobs started */
+   int   running;           /* threads still on the current job */
+   int   stop;
+   pthread_mutex_t mutex;
+   pthread_cond_t start, done;
+} Pool;
+
+/* A world of the library (see life.h) */
+struct Life {
+   const Engine* engine;
+   Update_fn* update;
+   uint32_t rule;
+   int      m, n, units;
+   size_t   size;           /* bytes in each of w[0] and w[1] */
+   void*    w[2];           /* w[0] is the current generation */
+   long     gen, live;
+   int      threads;
+   Pool*    pool;           /* NULL for one thread */
+   Padded_long* part_live;  /* each thread's population */
+   int      lut;            /* does it hold a table of Lut_hold */
+};
+
+/* Per-thread state of the dissemination barrier */
+typedef struct {
+   _Alignas(CACHE_LINE) atomic_int flags[2][MAX_ROUNDS];
+   int parity;
+   int sense;
+} Dissem_node;
+
+/* A pattern from --pattern, pasted into generation 0 */
+typedef struct {
+   const char* file;
+   int   rows, cols;
+   long  row, col;         /* where its upper left corner goes */
+   unsigned char* cells;   /* rows x cols LIVE/DEAD */
+} Pattern;
 
 /* Global Variables */
+Hl_node hl_cells[2];           /* the dead and the live cell */
+Hl_node** hl_table;
+size_t  hl_buckets, hl_count;
+long    hl_max_nodes = HL_MAX_NODES;
+Hl_node* hl_free;
+Hl_block* hl_blocks;
+Hl_node* hl_root;              /* the world at curr_gen */
+Hl_node* hl_empty[HL_MAX_LEVEL];  /* canonical empty nodes */
+uint64_t* sp_keys;             /* sparse neighbor table */
+unsigned char* sp_vals;
+size_t  sp_cap;
+int     plane = 0;             /* infinite plane, not a torus */
 int     thread_count;
 int     m, n, r, s, BREAK;
-int     live_count;
-int     curr_gen = 0, max_gens;
-int     *w1, *w2;
+int     units;
+long    live_count;        /* population of generation curr_gen */
+Padded_long* thread_live;  /* live cells in each thread's block */
+int     show_population = 0;
+int     output_mode = OUTPUT_ALL;
+long    output_every = 1;
+Snapshot snapshots[SNAPSHOTS];
+int     snap_head, snap_count, output_done;
+pthread_t writer;
+pthread_mutex_t output_mutex;
+pthread_cond_t snap_ready, snap_free;
+long    curr_gen = 0, max_gens;
+void    *w1, *w2;
+const Engine* engine;
+int     decomp_strip = 0;      /* partition rows only */
+int     tile_rows = 0, tile_cols = 0;  /* 0:  one tile per thread */
+Tile*   tiles;
+int*    first_tile;
+int     tile_count;
+int     sched_steal = 0;       /* work-stealing tile scheduler */
+Tile_queue* tile_queues;
+int     sched_pipeline = 0;    /* tiles run ahead, without a barrier */
+Tile_clock* tile_gen;          /* generation each tile has reached */
+void*   pipe_worlds[2];        /* generation g is in pipe_worlds[g % 2] */
+_Atomic long pipe_limit;       /* no tile may go past this generation */
+_Atomic long pipe_live[PIPE_DEPTH];  /* population of gen g in g % DEPTH */
+atomic_int pipe_tiles[PIPE_DEPTH];   /* tiles of gen g that are done */
+atomic_int pipe_stop;
+long    pipe_done;             /* last generation that's complete */
+pthread_mutex_t pipe_mutex;
+pthread_cond_t pipe_turn;
+int     halo_depth = 1;        /* generations between barriers */
+int     block_steps = 1;       /* generations in this round */
+long*   block_live;            /* each thread's population for each
+                                  generation of the round */
+int     block_stride;          /* longs per thread in block_live */
+size_t  deep_size;             /* bytes in a scratch world */
+Update_fn* deep_update;        /* halo kernel for the scratch worlds */
+int     pin_threads = 0;       /* pin thread rank to a core */
+int     huge_pages = 0;        /* back the worlds with huge pages */
+int     numa_place = 0;        /* bind each block to its thread's node */
+int*    cpus;                  /* cores to pin to, in rank order */
+int     cpu_count;
+int     use_mpi = 0;           /* one MPI process per block */
+Pattern patterns[MAX_PATTERNS];
+int     pattern_count = 0;
+long    checkpoint_every = 0;  /* checkpoint every k generations */
+const char* checkpoint_file = "pth_life.ckpt";
+int     packbits = 0;          /* compress the checkpoint bands */
+const char* restore_file = NULL;
+long    first_gen = 0;         /* generation the run starts from */
+int     out_format = FORMAT_TEXT;
+long    keyframe_every = 100;  /* frames between delta key frames */
+const char* index_file = NULL; /* frame index */
+FILE*   index_fp;
+uint64_t* prev_bits;           /* last printed world, for deltas */
+long    frames;                /* frames written so far */
+long long out_pos;             /* stdout offset of the next frame */
+char*   frame_buf;
+size_t  frame_used, frame_bytes;
+int     rle_line;              /* length of the current RLE line */
+uint32_t rule = RULE_CONWAY;   /* see RULE_NEXT */
+char    rule_name[MAX_RULE] = "B3/S23";
+Lut     luts[MAX_LUTS];        /* the tables in use */
+atomic_int lut_count;           /* slots of luts ever used */
+pthread_mutex_t lut_mutex = PTHREAD_MUTEX_INITIALIZER;
+uint64_t seed = 1;             /* key of the random generation 0 */
+uint64_t gen_threshold;        /* a cell is alive if its random
+                                  32-bit number is below this */
+int     active = 0;            /* skip tiles that can't change */
+unsigned char* changed[2];     /* did each tile change:  last gen, this gen */
+long*   tile_live;             /* live cells in each tile */
+int*    tile_nbrs;             /* each tile and its 8 neighbors */
+int     cache_block = 0;       /* units per column strip of a tile (cells
+                                  until Run_life), 0 for whole rows of
+                                  it, or -1 to tune */
+int     cycle_max = 0;         /* longest period --cycles looks for */
+int     cycle_period = 0;      /* the period found, or 0 */
+uint64_t* tile_hash;           /* hash of each tile of w1 (or w2) */
+uint64_t* recent_hash;         /* world hashes and populations of */
+long*   recent_live;           /*    the last cycle_max generations */
+char*   batch_file = NULL;     /* seeds and densities of --batch */
+Batch_world* batch;
+int     batch_count;
+atomic_int batch_next;         /* the next world to take */
+char*   bench_format = NULL;   /* "csv" or "json" for --bench */
+char*   bench_engines = NULL;  /* the lists of --bench-*, or NULL */
+char*   bench_sizes = NULL;    /*    for the defaults */
+char*   bench_densities = NULL;
+char*   bench_threads = NULL;
+char*   bench_barriers = NULL;
+Bench_mark* bench_marks = NULL; /* the generations of a bench run */
+long    bench_count, bench_cap;
+int     view_h = 0, view_w = 0;  /* pixels of a --view frame, or 0 */
+int     view_row = 0, view_col = 0;  /* the window of the world it */
+int     view_rows = 0, view_cols = 0; /*    shows, 0 for all of it */
+double  view_fps = 10;         /* most frames per second */
+char*   view_out = NULL;       /* unix:path, tcp:host:port or shm:name */
+int     view_due;              /* reduce this generation to a frame */
+double  view_next;             /* when the next frame is due */
+atomic_uint* view_count;       /* live cells under each pixel */
+int*    view_ybin;             /* pixel row of each window row, */
+int*    view_xbin;             /*    pixel col of each window col */
+int*    view_ycells;           /* window rows in each pixel row, */
+int*    view_xcells;           /*    window cols in each pixel col */
+unsigned char* view_frame;     /* header and pixels being sent */
+size_t  view_size;             /* bytes in a frame */
+int     view_busy, view_done;  /* is view_frame being sent; quit */
+int     view_fd = -1;          /* the socket, or -1 */
+View_ring* view_ring = NULL;   /* the shm ring, or NULL */
+pthread_t view_thread;
+pthread_mutex_t view_mutex;
+pthread_cond_t view_ready;
+#ifdef LIFE_PROFILE
+Prof_thread* prof = NULL;      /* the threads' counters, then the
+                                  writer's */
+_Thread_local Prof_thread* prof_me; /* the calling thread's, or NULL */
+double  prof_t0;               /* when the run started */
+char*   trace_file = NULL;     /* --trace */
+#endif
+const char* kernel_name = "auto";
+Update_fn* update;
+const Barrier_type* barrier;
 int     barrier_thread_count = 0;
+int     barrier_cycle = 0;
 pthread_mutex_t barrier_mutex;
 pthread_cond_t ok_to_proceed;
+atomic_int sense_count, sense_flag, parked;
+Padded_int* local_sense;
+Dissem_node* dissem_nodes;
+int     dissem_rounds;
 
 /* Serial Functions */
 void Usage(char prog_name[]);
-void Read_world(char prompt[], int w1[], int m, int n);
-void Gen_world(char prompt[], int w1[], int m, int n);
-void Print_world(char title[], int w1[]);
+void Get_args(int argc, char* argv[], char* ig_p);
+void Check_args(char ig, char prog_name[]);
+int Run_life(char ig);
+void Get_output_mode(const char val[], char prog_name[]);
+int Parse_rule(const char str[], uint32_t* rule_p);
+void Rule_name(uint32_t rule, char name[]);
+void Block_range(int total, int parts, int idx, int* start_p, int* end_p);
+void Make_tiles(void);
+void Find_tile_nbrs(int trows, int tcols);
+void Reset_tile_queues(void);
+int Next_tile(long rank);
+const Engine* Find_engine(const char name[]);
+Update_fn* Select_kernel(const Engine* engine, const char name[]);
+void Make_world(char ig, void* w1, Pool* pool);
+void Read_world(char prompt[], void* w1, int m, int n);
+void Gen_world(char prompt[], void* w1, int m, int n, Pool* pool);
+void Get_probability(char prompt[]);
+void* Gen_thread(void* rank);
+long Gen_rows(void* w1, int i0, int i1);
+void Gen_cells(uint64_t key, uint64_t threshold, int i, int j0, int j1,
+      char row[]);
+uint64_t Threshold(double prob);
+void Philox(uint32_t ctr[4], uint64_t key);
+long Store_world_row(void* w1, int m, int n, int i, char row[]);
+void Add_pattern(char arg[], char prog_name[]);
+void Load_pattern(Pattern* pat);
+const char* Map_file(const char file[], size_t* size_p);
+void Parse_rle(Pattern* pat, const char* text, const char* end);
+void Parse_cells(Pattern* pat, const char* text, const char* end);
+void Paste_patterns(int m, int n, int i, int j0, int j1, char row[]);
+void Print_world(char title[], const void* w1);
+void Make_title(char title[], long gen, long live);
+void Frames_start(void);
+void Frames_finish(void);
+void Write_frame(const void* w, long gen, long live);
+void Write_rle(const void* w, long gen, long live);
+void Write_delta(const void* w, long gen, long live);
+void Rle_run(long count, char tag);
+void Frame_put(const char text[], size_t len);
+void Frame_flush(void);
+int Want_output(long gen, int last);
+int Want_print(long gen, int last);
+int Want_checkpoint(long gen);
+void Write_checkpoint(const void* w, long gen, long live);
+void Restore_world(void* w1);
+size_t Packbits_encode(const unsigned char src[], size_t len,
+      unsigned char dst[]);
+size_t Packbits_decode(const unsigned char src[], size_t len,
+      unsigned char dst[], size_t size);
+int Gens_to_output(int most);
+void Output_start(void);
+void Output_world(const void* w1, long gen, long live);
+void Output_finish(void);
+void* Writer(void* arg);
+void View_start(void);
+int View_connect(const char dest[]);
+void View_tile(int t, unsigned char cells[]);
+void View_frame(void);
+void* View_sender(void* arg);
+void View_finish(void);
 int Count_nbhrs(int* w1, int m, int n, int i, int j);
 
+/* Dense engine:  one int per cell */
+int Dense_units(int n);
+size_t Dense_world_size(int m, int n);
+void Dense_store_row(void* w, int m, int n, int i, const char row[]);
+void Dense_load_row(const void* w, int m, int n, int i, char row[]);
+long Dense_update(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r);
+long Dense_update_window(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r);
+long Dense_window_strip(const int* cur, int* next, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r, int sum[]);
+size_t Dense_offset(int m, int n, int i, int col);
+void Dense_load_cells(const void* w, int m, int n, int i, int j, int len,
+      unsigned char cells[]);
+void Dense_store_cells(void* w, int m, int n, int i, int j, int len,
+      const unsigned char cells[]);
+
+/* Packed engine:  one bit per cell, 64 cells per uint64_t word */
+int Packed_units(int n);
+size_t Packed_world_size(int m, int n);
+void Packed_store_row(void* w, int m, int n, int i, const char row[]);
+void Packed_load_row(const void* w, int m, int n, int i, char row[]);
+long Packed_update(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r);
+size_t Packed_offset(int m, int n, int i, int col);
+long Lut_update(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r);
+void Packed_load_cells(const void* w, int m, int n, int i, int j, int len,
+      unsigned char cells[]);
+void Packed_store_cells(void* w, int m, int n, int i, int j, int len,
+      const unsigned char cells[]);
+
+/* Halo engine:  one byte per cell, padded by a ghost border */
+size_t Halo_world_size(int m, int n);
+void Halo_store_row(void* w, int m, int n, int i, const char row[]);
+void Halo_load_row(const void* w, int m, int n, int i, char row[]);
+long Halo_update(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r);
+long Halo_update_window(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r);
+void Halo_refresh(void* w, int m, int n, int row0, int row1,
+      int col0, int col1);
+size_t Halo_offset(int m, int n, int i, int col);
+void Halo_load_cells(const void* w, int m, int n, int i, int j, int len,
+      unsigned char cells[]);
+void Halo_store_cells(void* w, int m, int n, int i, int j, int len,
+      const unsigned char cells[]);
+
+/* HashLife engine:  loads and prints through the packed layout */
+Hl_node* Hl_find(Hl_node* nw, Hl_node* ne, Hl_node* sw, Hl_node* se);
+Hl_node* Hl_result(Hl_node* p, int j);
+Hl_node* Hl_build(const uint64_t w[], int level, long row, long col);
+void Hl_fill(const Hl_node* p, long row, long col, uint64_t w[]);
+Hl_node* Hl_step_pow2(Hl_node* t, int j);
+Hl_node* Hl_empty(int level);
+Hl_node* Hl_plane_step_pow2(Hl_node* t, int j, long* row_p, long* col_p);
+Hl_node* Hl_advance(Hl_node* t, long gens, long* row_p, long* col_p);
+void Hl_gc(Hl_node* root);
+void Hashlife_run(void);
+
+/* Sparse engine:  a list of the live cells */
+size_t Sparse_world_size(int m, int n);
+void Sparse_store_row(void* w, int m, int n, int i, const char row[]);
+void Sparse_load_row(const void* w, int m, int n, int i, char row[]);
+void Sparse_copy(void* dst, const void* src, int m, int n);
+void Sparse_release(void* w);
+void Sparse_step(Sparse_world* w);
+void Sparse_run(void);
+
+#ifdef USE_GPU
+/* GPU engines:  the kernels are in pth_life_gpu.cu */
+struct Gpu_world;
+struct Gpu_world* Gpu_create(int m, int n, int packed, int max_batch,
+      unsigned rule);
+void Gpu_upload(struct Gpu_world* g, const void* w);
+void Gpu_download(const struct Gpu_world* g, void* w);
+void Gpu_step(struct Gpu_world* g, int gens, long live[]);
+void Gpu_destroy(struct Gpu_world* g);
+void Gpu_run(void);
+void Gpu_packed_run(void);
+#endif
+
+/* SIMD kernels, chosen at run time by Select_kernel */
+int Has_window(void);
+#if defined(__x86_64__) || defined(__i386__)
+int Has_avx2(void);
+int Has_avx512(void);
+Update_fn Halo_update_avx2, Halo_update_avx512;
+Update_fn Packed_update_avx2, Packed_update_avx512;
+#endif
+#if defined(__aarch64__)
+int Has_neon(void);
+Update_fn Halo_update_neon, Packed_update_neon;
+#endif
+
 /* Parellel Function */
 void* Play_life(void* rank);
+long Update_tile(int t);
+long Step_tile(const void* cur, void* next, const Tile* tile);
+int Tune_cache_block(void);
+int Unit_cells(void);
+void Deep_start(void);
+const unsigned char* Lut_hold(uint32_t r);
+void Lut_release(uint32_t r);
+const unsigned char* Lut_table(uint32_t r);
+int Deep_steps(void);
+void Deep_tile(int t, unsigned char* deep[2], long live[]);
+void Deep_generations(void);
+int Tile_differs(const void* w1, const void* w2, const Tile* tile);
+uint64_t Hash_tile(const void* w, const Tile* tile, uint64_t key);
+uint64_t World_hash(void);
+int Find_cycle(uint64_t h, long gen, long live, long first,
+      uint64_t ring_hash[], long ring_live[]);
+void Batch_run(void);
+void Read_batch(const char file[]);
+void* Batch_thread(void* rank);
+void Batch_play(Batch_world* b, void* w[2], char row[],
+      uint64_t ring_hash[], long ring_live[]);
+void Bench_main(char ig, char prog_name[]);
+int Bench_split(char list[], char dflt[], char* items[]);
+int Bench_all_engines(const Engine* es[], const char* ks[]);
+void Bench_fork(Bench_run* b, char ig, char prog_name[]);
+void Bench_times(Bench_run* b);
+void Bench_print(const Bench_run runs[], int count);
+double Now(void);
+void Bench_stamp(void);
+#ifdef LIFE_PROFILE
+long Tile_cells(const Tile* tile);
+void Prof_start(void);
+void Prof_add(int phase, double t0, long gen, int tile);
+void Prof_finish(void);
+void Prof_report(void);
+void Prof_trace(const char file[]);
+#endif
+long Life_rows(Life* life, int row0, int row1);
+void Life_task(void* arg, long rank);
 void *Barrier(void* rank);
+void Next_generation(void);
+Pool* Pool_create(int threads);
+void Pool_run(Pool* pool, void* (*job)(void* rank));
+void Pool_run_task(Pool* pool, void (*task)(void* arg, long rank),
+      void* arg);
+void Pool_destroy(Pool* pool);
+void Pipe_start(void);
+void Pipe_finish(void);
+void* Play_pipeline(void* rank);
+void Pipe_generation(long gen);
+void* World_alloc(size_t size);
+void World_free(void* w, size_t size);
+void Find_cpus(void);
+#ifdef USE_MPI
+int Mpi_main(int* argc_p, char** argv_p[], char ig);
+#endif
+void* Place_thread(void* rank);
 
+/* Barriers */
+const Barrier_type* Find_barrier(const char name[]);
+void Mutex_barrier_init(int thread_count);
+void Mutex_barrier_wait(long rank, void (*serial)(void));
+void Mutex_barrier_destroy(void);
+void Sense_barrier_init(int thread_count);
+void Sense_barrier_wait(long rank, void (*serial)(void));
+void Sense_barrier_destroy(void);
+void Hybrid_barrier_wait(long rank, void (*serial)(void));
+void Dissem_barrier_init(int thread_count);
+void Dissem_barrier_wait(long rank, void (*serial)(void));
+void Dissem_episode(long rank);
+void Dissem_barrier_destroy(void);
+
+const Engine engines[] = {
+   {"dense", Dense_units, Dense_world_size, Dense_store_row,
+      Dense_load_row, Dense_update, NULL, Dense_offset, NULL,
+      NULL, NULL, 0, Dense_load_cells, Dense_store_cells},
+   {"packed", Packed_units, Packed_world_size, Packed_store_row,
+      Packed_load_row, Packed_update, NULL, Packed_offset, NULL,
+      NULL, NULL, 0, Packed_load_cells, Packed_store_cells},
+   {"lut", Packed_units, Packed_world_size, Packed_store_row,
+      Packed_load_row, Lut_update, NULL, Packed_offset, NULL,
+      NULL, NULL, 0, Packed_load_cells, Packed_store_cells},
+   {"halo", Dense_units, Halo_world_size, Halo_store_row,
+      Halo_load_row, Halo_update, Halo_refresh, Halo_offset, NULL,
+      NULL, NULL, 0, Halo_load_cells, Halo_store_cells},
+   {"hashlife", Packed_units, Packed_world_size, Packed_store_row,
+      Packed_load_row, NULL, NULL, Packed_offset, Hashlife_run,
+      NULL, NULL, 1, NULL, NULL},
+   {"sparse", Dense_units, Sparse_world_size, Sparse_store_row,
+      Sparse_load_row, NULL, NULL, NULL, Sparse_run,
+      Sparse_copy, Sparse_release, 1, NULL, NULL},
+#ifdef USE_GPU
+   {"gpu", Dense_units, Halo_world_size, Halo_store_row,
+      Halo_load_row, NULL, NULL, Halo_offset, Gpu_run,
+      NULL, NULL, 0, NULL, NULL},
+   {"gpu-packed", Packed_units, Packed_world_size, Packed_store_row,
+      Packed_load_row, NULL, NULL, Packed_offset, Gpu_packed_run,
+      NULL, NULL, 0, NULL, NULL},
+#endif
+};
+
+const Barrier_type barriers[] = {
+   {"mutex", Mutex_barrier_init, Mutex_barrier_wait, Mutex_barrier_destroy},
+   {"sense", Sense_barrier_init, Sense_barrier_wait, Sense_barrier_destroy},
+   {"hybrid", Sense_barrier_init, Hybrid_barrier_wait, Sense_barrier_destroy},
+   {"dissem", Dissem_barrier_init, Dissem_barrier_wait,
+      Dissem_barrier_destroy},
+};
+
+/* Fastest first:  "auto" takes the first one the host supports */
+const Kernel kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+   {"avx512", "halo", Has_avx512, Halo_update_avx512},
+   {"avx512", "packed", Has_avx512, Packed_update_avx512},
+   {"avx2", "halo", Has_avx2, Halo_update_avx2},
+   {"avx2", "packed", Has_avx2, Packed_update_avx2},
+#endif
+#if defined(__aarch64__)
+   {"neon", "halo", Has_neon, Halo_update_neon},
+   {"neon", "packed", Has_neon, Packed_update_neon},
+#endif
+   {"window", "halo", Has_window, Halo_update_window},
+   {"window", "dense", Has_window, Dense_update_window},
+   {NULL, NULL, NULL, NULL}
+};
+
+#ifndef LIFE_LIBRARY
 int main(int argc, char* argv[]){
    char       ig;
-   long       thread;
-   pthread_t* thread_handles;
-   char title[MAX_TITLE];
 
-   if (argc != 7) Usage(argv[0]);
-   thread_count = strtol(argv[1], NULL, 10) * strtol(argv[2], NULL, 10);
-   m = strtol(argv[3], NULL, 10);
-   n = strtol(argv[4], NULL, 10);
-   r = strtol(argv[1], NULL, 10);
-   s = strtol(argv[2], NULL, 10);
-   max_gens = strtol(argv[5], NULL, 10);
-   ig = argv[6][0];
+   Get_args(argc, argv, &ig);
+#  ifdef USE_MPI
+   if (use_mpi) return Mpi_main(&argc, &argv, ig);
+#  endif
+   if (bench_format != NULL) {
+      Bench_main(ig, argv[0]);
+      return 0;
+   }
+   return Run_life(ig);
+}
 
-   thread_handles = malloc(m*n*sizeof(pthread_t));
-   w1 = malloc(m*n*sizeof(int));
-   w2 = malloc(m*n*sizeof(int));
+/*---------------------------------------------------------------------
+ * Function:   Run_life
+ * Purpose:    Make generation 0 and play the world with the engine,
+ *             kernel, barrier and threads in the globals
+ * In arg:     ig:  'i', 'g' or 'e'
+ * Ret val:    0, the exit status
+ */
+int Run_life(char ig) {
+   Pool*      pool;
+   int        t;
 
-   pthread_mutex_init(&barrier_mutex, NULL);
-   pthread_cond_init(&ok_to_proceed, NULL);
+   units = engine->units(n);
+   Make_tiles();
+   update = Select_kernel(engine, kernel_name);
+   if (update == NULL && engine->run == NULL) {
+      fprintf(stderr, "Kernel %s is not available for the %s engine "
+            "on this host\n", kernel_name, engine->name);
+      exit(1);
+   }
+   if (update == Lut_update && Lut_hold(rule) == NULL) {
+      fprintf(stderr, "Can't make the lut engine's table\n");
+      exit(1);
+   }
+   if (batch_file != NULL) {
+      Batch_run();
+      return 0;
+   }
+   if (halo_depth > 1) Deep_start();
 
-   if (ig == 'i') 
-      Read_world("Enter generation 0", w1, m, n);
-   else
-      Gen_world("What's the probability that a cell is alive?", w1, m, n);
+   thread_live = aligned_alloc(CACHE_LINE, thread_count*sizeof(Padded_long));
+   w1 = World_alloc(engine->world_size(m, n));
+   w2 = engine->run == NULL ? World_alloc(engine->world_size(m, n)) : NULL;
 
-   printf("\n");
-   sprintf(title, "Generation %d:", curr_gen);
-   Print_world(title, w1);
+   /* Each thread touches its own blocks first, so that their pages
+      are on its node, before the world is read in */
+   pool = NULL;
+   if (engine->run == NULL) {
+      if (pin_threads) Find_cpus();
+      pool = Pool_create(thread_count);
+      if (pool == NULL) {
+         fprintf(stderr, "Can't start %d threads\n", thread_count);
+         exit(1);
+      }
+      Pool_run(pool, Place_thread);
+   }
 
-   for (thread = 0; thread < thread_count; thread++)
-   pthread_create(&thread_handles[thread], NULL,
-      Play_life, (void*) thread);
+   barrier->init(thread_count);
 
-   for (thread = 0; thread < thread_count; thread++)
-   pthread_join(thread_handles[thread], NULL);
+   Make_world(ig, w1, pool);
+   if (engine->refresh != NULL) engine->refresh(w1, m, n, 0, m, 0, units);
+   if (cache_block < 0)
+      cache_block = engine->run == NULL && halo_depth == 1
+                  ? Tune_cache_block() : 0;
+   else if (cache_block > 0)
+      cache_block = (cache_block + Unit_cells() - 1)/Unit_cells();
+   if (cycle_max > 0) {
+      for (t = 0; t < tile_count; t++)
+         tile_hash[t] = Hash_tile(w1, &tiles[t], t);
+      Find_cycle(World_hash(), curr_gen, live_count, first_gen,
+            recent_hash, recent_live);
+   }
 
-   if(curr_gen < max_gens) printf("There are no more live cells\n");
+   printf("\n");
+#  ifdef LIFE_PROFILE
+   if (pool != NULL) Prof_start();
+#  endif
+   Output_start();
+   if (view_h > 0) View_start();
+   if (Want_output(curr_gen, curr_gen == max_gens))
+      Output_world(w1, curr_gen, live_count);
 
-   pthread_mutex_destroy(&barrier_mutex);
-   pthread_cond_destroy(&ok_to_proceed);
-   free(w1);
-   free(w2);
-   free(thread_handles);
+   Bench_stamp();
+   if (engine->run != NULL) {
+      engine->run();
+   } else if (sched_pipeline) {
+      Pipe_start();
+      Pool_run(pool, Play_pipeline);
+      Pipe_finish();
+   } else {
+      Pool_run(pool, Play_life);
+   }
+   if (pool != NULL) Pool_destroy(pool);
+
+   if (view_h > 0) View_finish();
+   Output_finish();
+#  ifdef LIFE_PROFILE
+   if (prof != NULL) Prof_finish();
+#  endif
+   if (cycle_period > 0)
+      printf("Generation %ld repeats generation %ld:  the world has "
+            "period %d\n", curr_gen, curr_gen - cycle_period, cycle_period);
+   else if(curr_gen < max_gens) printf("There are no more live cells\n");
+
+   barrier->destroy();
+   if (engine->release != NULL) engine->release(w1);
+   World_free(w1, engine->world_size(m, n));
+   if (w2 != NULL) World_free(w2, engine->world_size(m, n));
+   if (pin_threads) free(cpus);
+   free(thread_live);
+   if (halo_depth > 1) free(block_live);
+   free(tiles);
+   free(first_tile);
+   if (sched_steal) free(tile_queues);
+   free(tile_nbrs);
+   if (active) {
+      free(changed[0]);
+      free(changed[1]);
+      free(tile_live);
+   }
+   if (cycle_max > 0) {
+      free(tile_hash);
+      free(recent_hash);
+      free(recent_live);
+   }
 
    return 0;
-}
+}  /* Run_life */
+
+/*---------------------------------------------------------------------
+ * Function:   Bench_main
+ * Purpose:    Run every configuration of --bench, each with output
+ *             off, and print how fast each one went
+ * In args:    ig:  'g' or 'e'
+ *             prog_name
+ * Global var: bench_engines, bench_sizes, bench_densities,
+ *             bench_threads, bench_barriers, r, s, m, n, barrier
+ *
+ * Note:       The configurations are every engine (or engine:kernel)
+ *             with every size, density, barrier and thread grid.
+ *             The serial engines (hashlife, sparse) have no barrier
+ *             or threads, and run once for each size and density.
+ *             Without --bench-engines, every engine runs with each
+ *             of its kernels that the host supports.
+ */
+void Bench_main(char ig, char prog_name[]) {
+   char* engs[MAX_BENCH];
+   char* sizes[MAX_BENCH];
+   char* dens[MAX_BENCH];
+   char* grids[MAX_BENCH];
+   char* bars[MAX_BENCH];
+   const Engine* es[MAX_BENCH];
+   const char* ks[MAX_BENCH];
+   char size0[64], grid0[64], dens0[] = "0.3", bar0[64], *colon, *end;
+   int ec, sc, dc, gc, bc, e, i, d, b, g, count = 0;
+   int bm, bn, br, bs;
+   const Barrier_type* bt;
+   Bench_run* runs;
+   Bench_run* run;
+
+   sprintf(size0, "%dx%d", m, n);
+   if (r*s > 1)
+      sprintf(grid0, "1x1,%dx%d", r, s);
+   else
+      strcpy(grid0, "1x1");
+   snprintf(bar0, sizeof(bar0), "%s", barrier->name);
+   sc = Bench_split(bench_sizes, size0, sizes);
+   dc = Bench_split(bench_densities, dens0, dens);
+   gc = Bench_split(bench_threads, grid0, grids);
+   bc = Bench_split(bench_barriers, bar0, bars);
+   if (bench_engines == NULL) {
+      ec = Bench_all_engines(es, ks);
+   } else {
+      ec = Bench_split(bench_engines, NULL, engs);
+      for (e = 0; e < ec; e++) {
+         colon = strchr(engs[e], ':');
+         if (colon != NULL) *colon = '\0';
+         es[e] = Find_engine(engs[e]);
+         if (es[e] == NULL) Usage(prog_name);
+         ks[e] = es[e]->run != NULL ? NULL
+               : colon != NULL ? colon + 1 : kernel_name;
+      }
+   }
+   for (b = 0; b < bc; b++)
+      if (Find_barrier(bars[b]) == NULL) Usage(prog_name);
+
+   runs = calloc((size_t) ec*sc*dc*bc*gc, sizeof(Bench_run));
+   for (e = 0; e < ec; e++)
+      for (i = 0; i < sc; i++) {
+         bm = strtol(sizes[i], &end, 10);
+         bn = *end == 'x' ? strtol(end + 1, NULL, 10) : bm;
+         for (d = 0; d < dc; d++)
+            for (b = 0; b < bc; b++) {
+               bt = Find_barrier(bars[b]);
+               for (g = 0; g < gc; g++) {
+                  br = strtol(grids[g], &end, 10);
+                  bs = *end == 'x' ? strtol(end + 1, NULL, 10) : 1;
+                  if (es[e]->run != NULL && (b > 0 || g > 0)) continue;
+                  run = &runs[count++];
+                  run->engine = es[e];
+                  run->kernel = ks[e];
+                  run->barrier = es[e]->run != NULL ? NULL : bt;
+                  run->m = bm;
+                  run->n = bn;
+                  run->r = es[e]->run != NULL ? 1 : br;
+                  run->s = es[e]->run != NULL ? 1 : bs;
+                  run->density = strtod(dens[d], NULL);
+                  Bench_fork(run, ig, prog_name);
+               }
+            }
+      }
+
+   Bench_print(runs, count);
+   free(runs);
+}  /* Bench_main */
+
+/*---------------------------------------------------------------------
+ * Function:   Bench_split
+ * Purpose:    Split a comma separated list of --bench in place
+ * In args:    list:  the list (in argv), or NULL for dflt
+ *             dflt:  the default list
+ * Out arg:    items:  pointers into list or dflt
+ * Ret val:    The number of items, at most MAX_BENCH
+ */
+int Bench_split(char list[], char dflt[], char* items[]) {
+   char* save;
+   char* item;
+   int count = 0;
+
+   for (item = strtok_r(list != NULL ? list : dflt, ",", &save);
+         item != NULL && count < MAX_BENCH;
+         item = strtok_r(NULL, ",", &save))
+      items[count++] = item;
+   return count;
+}  /* Bench_split */
+
+/*---------------------------------------------------------------------
+ * Function:   Bench_all_engines
+ * Purpose:    List every engine, with each of its kernels that runs
+ *             on this host
+ * Out args:   es:  the engines
+ *             ks:  the kernels, NULL for the engines without any
+ * Ret val:    The number of engine:kernel pairs
+ */
+int Bench_all_engines(const Engine* es[], const char* ks[]) {
+   const Kernel* k;
+   int e, count = 0;
+
+   for (e = 0; e < sizeof(engines)/sizeof(engines[0]); e++) {
+      es[count] = &engines[e];
+      ks[count++] = engines[e].run != NULL ? NULL : "scalar";
+      if (engines[e].run != NULL) continue;
+      for (k = kernels; k->name != NULL; k++)
+         if (strcmp(k->engine, engines[e].name) == 0 && k->supported()
+               && count < MAX_BENCH) {
+            es[count] = &engines[e];
+            ks[count++] = k->name;
+         }
+   }
+   return count;
+}  /* Bench_all_engines */
+
+/*---------------------------------------------------------------------
+ * Function:   Bench_fork
+ * Purpose:    Run one configuration of --bench in a child process
+ * In args:    ig, prog_name
+ * In/out arg: b:  the configuration in, its times out
+ * Global var: m, n, r, s, thread_count, engine, kernel_name,
+ *             barrier, gen_threshold, output_mode, bench_marks,
+ *             bench_count, bench_cap
+ *
+ * Note:       Each run starts from a fresh process, so it doesn't
+ *             inherit the state of the one before, and a run that
+ *             quits (hashlife with sizes that aren't powers of two,
+ *             say) is only skipped.  The child's stdout goes to
+ *             /dev/null, and it sends its times back through a pipe.
+ */
+void Bench_fork(Bench_run* b, char ig, char prog_name[]) {
+   Bench_run got;
+   int fd[2], status;
+   pid_t pid;
+
+   fflush(stdout);
+   if (pipe(fd) != 0) {
+      perror("pipe");
+      exit(1);
+   }
+   pid = fork();
+   if (pid == 0) {
+      close(fd[0]);
+      m = b->m;
+      n = b->n;
+      r = b->r;
+      s = b->s;
+      thread_count = r*s;
+      engine = b->engine;
+      if (b->kernel != NULL) kernel_name = b->kernel;
+      if (b->barrier != NULL) barrier = b->barrier;
+      gen_threshold = Threshold(b->density);
+      output_mode = OUTPUT_NONE;
+      Check_args(ig, prog_name);
+      if (freopen("/dev/null", "w", stdout) == NULL) _exit(1);
+      bench_cap = max_gens + 2;
+      bench_marks = malloc(bench_cap*sizeof(Bench_mark));
+      bench_count = 0;
+      Run_life(ig);
+      Bench_times(b);
+      if (write(fd[1], b, sizeof(Bench_run)) != sizeof(Bench_run))
+         _exit(1);
+      _exit(0);
+   }
+
+   close(fd[1]);
+   b->ok = pid > 0 && read(fd[0], &got, sizeof(got)) == sizeof(got);
+   close(fd[0]);
+   if (pid > 0) waitpid(pid, &status, 0);
+   if (b->ok && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+      b->gens = got.gens;
+      b->seconds = got.seconds;
+      memcpy(b->lat, got.lat, sizeof(b->lat));
+   } else {
+      b->ok = 0;
+      fprintf(stderr, "Skipping %s%s%s %dx%d, %dx%d threads:  the run "
+            "failed\n", b->engine->name, b->kernel != NULL ? ":" : "",
+            b->kernel != NULL ? b->kernel : "", b->m, b->n, b->r, b->s);
+   }
+}  /* Bench_fork */
+
+/*---------------------------------------------------------------------
+ * Function:   Bench_compare
+ * Purpose:    Order doubles for qsort
+ */
+static int Bench_compare(const void* a, const void* b) {
+   double x = *(const double*) a, y = *(const double*) b;
+
+   return x < y ? -1 : x > y;
+}  /* Bench_compare */
+
+/*---------------------------------------------------------------------
+ * Function:   Bench_times
+ * Purpose:    Turn the marks of a --bench run into its time and the
+ *             percentiles of its time per generation
+ * Out arg:    b:  gens, seconds and lat
+ * Global var: bench_marks, bench_count
+ *
+ * Note:       The engines that advance several generations between
+ *             marks (--halo-depth, the gpu engines, and hashlife,
+ *             which jumps straight to max with output off) give each
+ *             of them an equal share of the time.
+ */
+void Bench_times(Bench_run* b) {
+   const Bench_mark* first = &bench_marks[0];
+   const Bench_mark* last = &bench_marks[bench_count - 1];
+   double* lat;
+   double dt;
+   long k, g, dg, count = 0;
+
+   b->gens = last->gen - first->gen;
+   b->seconds = last->time - first->time;
+   memset(b->lat, 0, sizeof(b->lat));
+   if (b->gens <= 0) return;
+
+   lat = malloc(b->gens*sizeof(double));
+   for (k = 1; k < bench_count; k++) {
+      dg = bench_marks[k].gen - bench_marks[k-1].gen;
+      dt = bench_marks[k].time - bench_marks[k-1].time;
+      for (g = 0; g < dg; g++)
+         lat[count++] = dt/dg;
+   }
+   qsort(lat, count, sizeof(double), Bench_compare);
+   b->lat[0] = lat[(count - 1)*50/100];
+   b->lat[1] = lat[(count - 1)*90/100];
+   b->lat[2] = lat[(count - 1)*99/100];
+   b->lat[3] = lat[count - 1];
+   free(lat);
+}  /* Bench_times */
+
+/*---------------------------------------------------------------------
+ * Function:   Bench_print
+ * Purpose:    Print the --bench table as CSV or JSON
+ * In args:    runs, count
+ * Global var: bench_format
+ *
+ * Note:       cells_per_sec is cell updates per second, m*n per
+ *             generation.  The efficiency of a run with p threads is
+ *             its cells_per_sec over p times that of the same engine,
+ *             kernel, size, density and barrier with one thread, or
+ *             empty (null) if there's no such run.
+ */
+void Bench_print(const Bench_run runs[], int count) {
+   const Bench_run* b;
+   const Bench_run* base;
+   double cps, base_cps;
+   char eff[32];
+   int json = strcmp(bench_format, "json") == 0;
+   int k, j, printed = 0;
+
+   if (json)
+      printf("[\n");
+   else
+      printf("engine,kernel,m,n,density,r,c,threads,barrier,generations,"
+            "seconds,cells_per_sec,p50_us,p90_us,p99_us,max_us,"
+            "efficiency\n");
+   for (k = 0; k < count; k++) {
+      b = &runs[k];
+      if (!b->ok) continue;
+      cps = b->seconds > 0 ? b->gens*(double) b->m*b->n/b->seconds : 0;
+      base = NULL;
+      for (j = 0; j < count && base == NULL; j++)
+         if (runs[j].ok && runs[j].r*runs[j].s == 1
+               && runs[j].engine == b->engine
+               && runs[j].barrier == b->barrier
+               && (runs[j].kernel == b->kernel
+                  || (runs[j].kernel != NULL && b->kernel != NULL
+                     && strcmp(runs[j].kernel, b->kernel) == 0))
+               && runs[j].m == b->m && runs[j].n == b->n
+               && runs[j].density == b->density)
+            base = &runs[j];
+      base_cps = base == NULL || base->seconds <= 0 ? 0
+               : base->gens*(double) base->m*base->n/base->seconds;
+      if (base_cps > 0)
+         sprintf(eff, "%.3f", cps/(base_cps*b->r*b->s));
+      else
+         strcpy(eff, json ? "null" : "");
+
+      if (json)
+         printf("%s  {\"engine\": \"%s\", \"kernel\": \"%s\", \"m\": %d, "
+               "\"n\": %d, \"density\": %g, \"r\": %d, \"c\": %d, "
+               "\"threads\": %d, \"barrier\": \"%s\", "
+               "\"generations\": %ld, \"seconds\": %.6f, "
+               "\"cells_per_sec\": %.4e, \"p50_us\": %.3f, "
+               "\"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, "
+               "\"efficiency\": %s}", printed > 0 ? ",\n" : "",
+               b->engine->name, b->kernel != NULL ? b->kernel : "none",
+               b->m, b->n, b->density, b->r, b->s, b->r*b->s,
+               b->barrier != NULL ? b->barrier->name : "none", b->gens,
+               b->seconds, cps, b->lat[0]*1e6, b->lat[1]*1e6,
+               b->lat[2]*1e6, b->lat[3]*1e6, eff);
+      else
+         printf("%s,%s,%d,%d,%g,%d,%d,%d,%s,%ld,%.6f,%.4e,%.3f,%.3f,"
+               "%.3f,%.3f,%s\n", b->engine->name,
+               b->kernel != NULL ? b->kernel : "none", b->m, b->n,
+               b->density, b->r, b->s, b->r*b->s,
+               b->barrier != NULL ? b->barrier->name : "none", b->gens,
+               b->seconds, cps, b->lat[0]*1e6, b->lat[1]*1e6,
+               b->lat[2]*1e6, b->lat[3]*1e6, eff);
+      printed++;
+   }
+   if (json) printf("%s]\n", printed > 0 ? "\n" : "");
+}  /* Bench_print */
+#endif
 
 /*---------------------------------------------------------------------
  * Function:   Usage
@@ -138,7 +1478,7 @@ int main(int argc, char* argv[]){
  * In arg:     prog_name
  */
  void Usage(char prog_name[]) {
-   fprintf(stderr, "usage: %s <r> <c> <m> <n> <max> <i|g>\n", prog_name);
+   fprintf(stderr, "usage: %s <r> <c> <m> <n> <max> <i|g|e>\n", prog_name);
    fprintf(stderr, "    r   = number of rows of threads\n");
    fprintf(stderr, "    c   = number of cols of threads\n");
    fprintf(stderr, "    m   = number of rows in the world\n");
@@ -146,203 +1486,6316 @@ int main(int argc, char* argv[]){
    fprintf(stderr, "    max = max number of generations\n");
    fprintf(stderr, "    i   = user will enter generation 0\n");
    fprintf(stderr, "    g   = program should generate generation 0\n");
+   fprintf(stderr, "    e   = generation 0 is empty (but for --pattern)\n");
+   fprintf(stderr, "options:\n");
+   fprintf(stderr, "    --engine=dense   one int per cell (default)\n");
+   fprintf(stderr, "    --engine=packed  one bit per cell\n");
+   fprintf(stderr, "    --engine=halo    one byte per cell, ghost border\n");
+   fprintf(stderr,
+         "    --engine=lut     one bit per cell, 2x2 table lookups\n");
+   fprintf(stderr, "    --engine=hashlife  HashLife (m, n powers of 2)\n");
+   fprintf(stderr, "    --engine=gpu|gpu-packed  on the GPU (USE_GPU)\n");
+   fprintf(stderr,
+         "    --hl-nodes=N     HashLife nodes kept before collecting\n");
+   fprintf(stderr, "    --engine=sparse  hash the live cells only\n");
+   fprintf(stderr, "    --topology=torus|plane\n");
+   fprintf(stderr,
+         "                     plane:  infinite (hashlife, sparse)\n");
+   fprintf(stderr, "    --kernel=auto|scalar|avx2|avx512|neon|window\n");
+   fprintf(stderr, "                     SIMD kernel for packed and halo\n");
+   fprintf(stderr,
+         "                     (window:  column sums, dense and halo)\n");
+   fprintf(stderr, "    --barrier=mutex|sense|hybrid|dissem\n");
+   fprintf(stderr, "                     barrier between generations\n");
+   fprintf(stderr,
+         "    --population     print the population of each generation\n");
+   fprintf(stderr, "    --decomp=block|strip\n");
+   fprintf(stderr,
+         "                     threads own r x c blocks, or r*c strips\n");
+   fprintf(stderr, "    --tiles=TRxTC    cut the world into TR x TC tiles\n");
+   fprintf(stderr, "    --sched=static|steal|pipeline\n");
+   fprintf(stderr,
+         "                     threads keep their tiles, steal, or\n");
+   fprintf(stderr, "                     run tiles ahead without a barrier\n");
+   fprintf(stderr, "    --halo-depth=k   k generations per barrier\n");
+   fprintf(stderr, "    --active         skip tiles that can't change\n");
+   fprintf(stderr,
+         "    --cycles=P       stop if the world repeats within P gens\n");
+   fprintf(stderr,
+         "    --batch=file     one 'g' world per \"seed density\" line\n");
+   fprintf(stderr, "    --bench=csv|json benchmark every engine and kernel\n");
+   fprintf(stderr, "    --bench-engines=engine[:kernel],...\n");
+   fprintf(stderr, "    --bench-sizes=MxN,...  --bench-densities=p,...\n");
+   fprintf(stderr, "    --bench-threads=RxC,...  --bench-barriers=name,...\n");
+   fprintf(stderr, "                     what --bench runs\n");
+   fprintf(stderr, "    --view=HxW       stream an H x W density picture\n");
+   fprintf(stderr, "    --view-window=row,col,RxC\n");
+   fprintf(stderr, "                     part of the world to show\n");
+   fprintf(stderr, "    --view-fps=F     most frames a second (default 10)\n");
+   fprintf(stderr, "    --view-out=unix:path|tcp:host:port|shm:name\n");
+   fprintf(stderr, "                     where to send the frames\n");
+   fprintf(stderr,
+         "    --trace=file     Chrome trace of the threads (LIFE_PROFILE)\n");
+   fprintf(stderr, "    --pin            pin each thread to a core\n");
+   fprintf(stderr,
+         "    --numa           pin, and bind blocks to nodes (USE_NUMA)\n");
+   fprintf(stderr, "    --hugepages      back the worlds with huge pages\n");
+   fprintf(stderr, "    --cache-block=auto|off|W\n");
+   fprintf(stderr, "                     step tiles in strips of W cells\n");
+   fprintf(stderr,
+         "    --mpi            one MPI process per block (USE_MPI)\n");
+   fprintf(stderr, "    --pattern=file[@row,col]\n");
+   fprintf(stderr, "                     paste an RLE or .cells pattern\n");
+   fprintf(stderr, "    --format=text|rle|delta\n");
+   fprintf(stderr, "                     how the generations are printed\n");
+   fprintf(stderr,
+         "    --keyframe=K     delta key frame every K (default 100)\n");
+   fprintf(stderr, "    --index=file     write an index of the frames\n");
+   fprintf(stderr,
+         "    --rule=B3/S23    Life-like rule (or highlife, daynight)\n");
+   fprintf(stderr, "    --seed=N         seed for 'g' (default 1)\n");
+   fprintf(stderr, "    --checkpoint=k   checkpoint every k generations\n");
+   fprintf(stderr, "    --checkpoint-file=file\n");
+   fprintf(stderr, "                     where (default pth_life.ckpt)\n");
+   fprintf(stderr, "    --packbits       compress the checkpoint\n");
+   fprintf(stderr, "    --restore=file   start from a checkpoint\n");
+   fprintf(stderr, "    --output=all|final|none|k\n");
+   fprintf(stderr, "                     which generations to print\n");
    exit(0);
 }  /* Usage */
 
 /*---------------------------------------------------------------------
- * Function:   Read_world
- * Purpose:    Get generation 0 from the user
- * In args:    prompt
- *             m:  number of rows in visible world
- *             n:  number of cols in visible world
- * Out arg:    w1:  stores generation 0
- *
+ * Function:   Get_args
+ * Purpose:    Get the command line args and options
+ * In args:    argc, argv
+ * Out arg:    ig_p:  'i' or 'g'
+ * Globals:    thread_count, r, s, m, n, max_gens, engine, kernel_name,
+ *             barrier, show_population, output_mode, output_every,
+ *             decomp_strip, tile_rows, tile_cols, sched_steal,
+ *             sched_pipeline, halo_depth, active, pin_threads,
+ *             huge_pages, numa_place, use_mpi, patterns,
+ *             checkpoint_every, checkpoint_file, packbits,
+ *             restore_file, seed, out_format, keyframe_every,
+ *             index_file, rule, rule_name,
+ *             hl_max_nodes, plane, bench_format, bench_engines,
+ *             bench_sizes, bench_densities, bench_threads,
+ *             bench_barriers, view_h, view_w, view_row, view_col,
+ *             view_rows, view_cols, view_fps, view_out, trace_file
  */
- void Read_world(char prompt[], int w1[], int m, int n) {
-   int i, j;
-   char c;
+void Get_args(int argc, char* argv[], char* ig_p) {
+   int arg;
+   char* end;
 
-   printf("%s\n", prompt);
-   for (i = 0; i < m; i++) {
-      for (j = 0; j < n; j++) {
-         scanf("%c", &c);
-         if (c == LIVE_IO)
-            w1[i*n + j] = LIVE;
-         else
-            w1[i*n + j] = DEAD;
+   if (argc < 7) Usage(argv[0]);
+   r = strtol(argv[1], NULL, 10);
+   s = strtol(argv[2], NULL, 10);
+   thread_count = r*s;
+   m = strtol(argv[3], NULL, 10);
+   n = strtol(argv[4], NULL, 10);
+   max_gens = strtol(argv[5], NULL, 10);
+   *ig_p = argv[6][0];
+   engine = &engines[0];
+   barrier = &barriers[0];
+
+   for (arg = 7; arg < argc; arg++) {
+      if (strncmp(argv[arg], "--engine=", 9) == 0) {
+         engine = Find_engine(argv[arg] + 9);
+         if (engine == NULL) Usage(argv[0]);
+      } else if (strncmp(argv[arg], "--barrier=", 10) == 0) {
+         barrier = Find_barrier(argv[arg] + 10);
+         if (barrier == NULL) Usage(argv[0]);
+      } else if (strncmp(argv[arg], "--output=", 9) == 0) {
+         Get_output_mode(argv[arg] + 9, argv[0]);
+      } else if (strcmp(argv[arg], "--decomp=block") == 0) {
+         decomp_strip = 0;
+      } else if (strcmp(argv[arg], "--decomp=strip") == 0) {
+         decomp_strip = 1;
+      } else if (strncmp(argv[arg], "--tiles=", 8) == 0) {
+         tile_rows = strtol(argv[arg] + 8, &end, 10);
+         tile_cols = *end == 'x' ? strtol(end + 1, NULL, 10) : 1;
+         if (tile_rows <= 0 || tile_cols <= 0) Usage(argv[0]);
+      } else if (strcmp(argv[arg], "--sched=static") == 0) {
+         sched_steal = sched_pipeline = 0;
+      } else if (strcmp(argv[arg], "--sched=steal") == 0) {
+         sched_steal = 1;
+         sched_pipeline = 0;
+      } else if (strcmp(argv[arg], "--sched=pipeline") == 0) {
+         sched_steal = 0;
+         sched_pipeline = 1;
+      } else if (strncmp(argv[arg], "--hl-nodes=", 11) == 0) {
+         hl_max_nodes = strtol(argv[arg] + 11, NULL, 10);
+         if (hl_max_nodes <= 0) Usage(argv[0]);
+      } else if (strncmp(argv[arg], "--halo-depth=", 13) == 0) {
+         halo_depth = strtol(argv[arg] + 13, NULL, 10);
+         if (halo_depth <= 0) Usage(argv[0]);
+      } else if (strcmp(argv[arg], "--pin") == 0) {
+         pin_threads = 1;
+      } else if (strcmp(argv[arg], "--hugepages") == 0) {
+         huge_pages = 1;
+      } else if (strcmp(argv[arg], "--numa") == 0) {
+#        ifdef USE_NUMA
+         numa_place = pin_threads = 1;
+#        else
+         fprintf(stderr, "--numa needs a build with -DUSE_NUMA -lnuma\n");
+         exit(1);
+#        endif
+      } else if (strncmp(argv[arg], "--view=", 7) == 0) {
+         view_h = strtol(argv[arg] + 7, &end, 10);
+         view_w = *end == 'x' ? strtol(end + 1, NULL, 10) : 0;
+         if (view_h <= 0 || view_w <= 0) Usage(argv[0]);
+      } else if (strncmp(argv[arg], "--view-window=", 14) == 0) {
+         view_row = strtol(argv[arg] + 14, &end, 10);
+         view_col = *end == ',' ? strtol(end + 1, &end, 10) : -1;
+         view_rows = *end == ',' ? strtol(end + 1, &end, 10) : 0;
+         view_cols = *end == 'x' ? strtol(end + 1, NULL, 10) : 0;
+         if (view_row < 0 || view_col < 0 || view_rows <= 0
+               || view_cols <= 0)
+            Usage(argv[0]);
+      } else if (strncmp(argv[arg], "--view-fps=", 11) == 0) {
+         view_fps = strtod(argv[arg] + 11, NULL);
+         if (view_fps <= 0) Usage(argv[0]);
+      } else if (strncmp(argv[arg], "--view-out=", 11) == 0) {
+         view_out = argv[arg] + 11;
+      } else if (strncmp(argv[arg], "--trace=", 8) == 0) {
+#        ifdef LIFE_PROFILE
+         trace_file = argv[arg] + 8;
+#        else
+         fprintf(stderr, "--trace needs a build with -DLIFE_PROFILE\n");
+         exit(1);
+#        endif
+      } else if (strcmp(argv[arg], "--mpi") == 0) {
+#        ifdef USE_MPI
+         use_mpi = 1;
+#        else
+         fprintf(stderr, "--mpi needs a build with mpicc -DUSE_MPI\n");
+         exit(1);
+#        endif
+      } else if (strncmp(argv[arg], "--checkpoint=", 13) == 0) {
+         checkpoint_every = strtol(argv[arg] + 13, NULL, 10);
+         if (checkpoint_every <= 0) Usage(argv[0]);
+      } else if (strncmp(argv[arg], "--checkpoint-file=", 18) == 0) {
+         checkpoint_file = argv[arg] + 18;
+      } else if (strcmp(argv[arg], "--format=text") == 0) {
+         out_format = FORMAT_TEXT;
+      } else if (strcmp(argv[arg], "--format=rle") == 0) {
+         out_format = FORMAT_RLE;
+      } else if (strcmp(argv[arg], "--format=delta") == 0) {
+         out_format = FORMAT_DELTA;
+      } else if (strncmp(argv[arg], "--keyframe=", 11) == 0) {
+         keyframe_every = strtol(argv[arg] + 11, NULL, 10);
+         if (keyframe_every <= 0) Usage(argv[0]);
+      } else if (strncmp(argv[arg], "--index=", 8) == 0) {
+         index_file = argv[arg] + 8;
+      } else if (strncmp(argv[arg], "--rule=", 7) == 0) {
+         if (!Parse_rule(argv[arg] + 7, &rule)) {
+            fprintf(stderr, "Can't use the rule %s:  it should be like "
+                  "B36/S23, with no B0\n", argv[arg] + 7);
+            exit(1);
+         }
+         Rule_name(rule, rule_name);
+      } else if (strncmp(argv[arg], "--seed=", 7) == 0) {
+         errno = 0;
+         seed = strtoull(argv[arg] + 7, &end, 10);
+         if (errno != 0 || end == argv[arg] + 7 || *end != '\0'
+               || argv[arg][7] == '-')
+            Usage(argv[0]);
+      } else if (strcmp(argv[arg], "--packbits") == 0) {
+         packbits = 1;
+      } else if (strncmp(argv[arg], "--restore=", 10) == 0) {
+         restore_file = argv[arg] + 10;
+      } else if (strncmp(argv[arg], "--pattern=", 10) == 0) {
+         Add_pattern(argv[arg] + 10, argv[0]);
+      } else if (strcmp(argv[arg], "--active") == 0) {
+         active = 1;
+      } else if (strncmp(argv[arg], "--batch=", 8) == 0) {
+         batch_file = argv[arg] + 8;
+      } else if (strcmp(argv[arg], "--bench=csv") == 0
+            || strcmp(argv[arg], "--bench=json") == 0) {
+         bench_format = argv[arg] + 8;
+      } else if (strncmp(argv[arg], "--bench-engines=", 16) == 0) {
+         bench_engines = argv[arg] + 16;
+      } else if (strncmp(argv[arg], "--bench-sizes=", 14) == 0) {
+         bench_sizes = argv[arg] + 14;
+      } else if (strncmp(argv[arg], "--bench-densities=", 18) == 0) {
+         bench_densities = argv[arg] + 18;
+      } else if (strncmp(argv[arg], "--bench-threads=", 16) == 0) {
+         bench_threads = argv[arg] + 16;
+      } else if (strncmp(argv[arg], "--bench-barriers=", 17) == 0) {
+         bench_barriers = argv[arg] + 17;
+      } else if (strncmp(argv[arg], "--cache-block=", 14) == 0) {
+         if (strcmp(argv[arg] + 14, "auto") == 0)
+            cache_block = -1;
+         else if (strcmp(argv[arg] + 14, "off") == 0)
+            cache_block = 0;
+         else if ((cache_block = strtol(argv[arg] + 14, NULL, 10)) <= 0)
+            Usage(argv[0]);
+      } else if (strncmp(argv[arg], "--cycles=", 9) == 0) {
+         cycle_max = strtol(argv[arg] + 9, NULL, 10);
+         if (cycle_max <= 0) Usage(argv[0]);
+      } else if (strcmp(argv[arg], "--population") == 0) {
+         show_population = 1;
+      } else if (strcmp(argv[arg], "--topology=torus") == 0) {
+         plane = 0;
+      } else if (strcmp(argv[arg], "--topology=plane") == 0) {
+         plane = 1;
+      } else if (strncmp(argv[arg], "--kernel=", 9) == 0) {
+         kernel_name = argv[arg] + 9;
+      } else {
+         Usage(argv[0]);
       }
-      /* Read end of line character */
-      scanf("%c", &c);
    }
-}  /* Read_world */
+   if (bench_format == NULL) {
+      Check_args(*ig_p, argv[0]);
+   } else if (*ig_p == 'i' || use_mpi || batch_file != NULL) {
+      fprintf(stderr, "--bench needs 'g' or 'e', without --mpi or "
+            "--batch\n");
+      exit(1);
+   }
+}  /* Get_args */
 
 /*---------------------------------------------------------------------
- * Function:   Gen_world
- * Purpose:    Use a random number generator to create generation 0 
- * In args:    prompt
- *             m:  number of rows in visible world
- *             n:  number of cols in visible world
- * Out arg:    w1:  stores generation 0
+ * Function:   Check_args
+ * Purpose:    Quit if the sizes, engine and options of a run don't
+ *             go together
+ * In args:    ig, prog_name
  *
+ * Note:       With --bench each configuration is checked by itself,
+ *             after its engine and sizes are set.
  */
-void Gen_world(char prompt[], int w1[], int m, int n) {
-   int i, j;
-   double prob;
-#  ifdef DEBUG
-   int live_count = 0;
-#  endif
-   
-   printf("%s\n", prompt);
-   scanf("%lf", &prob);
+void Check_args(char ig, char prog_name[]) {
+   if (r <= 0 || s <= 0 || m <= 0 || n <= 0) Usage(prog_name);
+   if (plane && !engine->plane) {
+      fprintf(stderr, "The %s engine only runs on the torus\n",
+            engine->name);
+      exit(1);
+   }
+   if ((active || halo_depth > 1) && sched_pipeline) {
+      fprintf(stderr, "--active and --halo-depth need --sched=static "
+            "or --sched=steal\n");
+      exit(1);
+   }
+   if (active && halo_depth > 1) {
+      fprintf(stderr, "--active only works with --halo-depth=1\n");
+      exit(1);
+   }
+   if (batch_file != NULL && (engine->run != NULL || ig != 'g'
+            || use_mpi || restore_file != NULL || checkpoint_every > 0)) {
+      fprintf(stderr, "--batch needs 'g' and the dense, packed, lut or "
+            "halo engine, without --mpi, --restore or --checkpoint\n");
+      exit(1);
+   }
+   if (cycle_max > 0 && batch_file == NULL && (engine->run != NULL
+            || halo_depth > 1 || sched_pipeline || use_mpi)) {
+      fprintf(stderr, "--cycles needs the dense, packed, lut or halo "
+            "engine, with --halo-depth=1 and --sched=static or steal\n");
+      exit(1);
+   }
+   if (restore_file != NULL && pattern_count > 0) {
+      fprintf(stderr, "--pattern can't be used with --restore\n");
+      exit(1);
+   }
+   if (halo_depth > 1 && engine->store_cells == NULL) {
+      fprintf(stderr, "The %s engine can't use --halo-depth\n",
+            engine->name);
+      exit(1);
+   }
+   if (view_h > 0 && (view_out == NULL || engine->load_cells == NULL
+            || halo_depth > 1 || sched_pipeline || use_mpi
+            || batch_file != NULL)) {
+      fprintf(stderr, "--view needs --view-out, and the dense, packed, "
+            "lut or halo engine, with --halo-depth=1 and --sched=static "
+            "or steal\n");
+      exit(1);
+   }
+   if (view_h > 0 && view_rows == 0) {
+      view_rows = m;
+      view_cols = n;
+   }
+   if (view_h > 0 && (view_row + view_rows > m || view_col + view_cols > n
+            || view_h > view_rows || view_w > view_cols)) {
+      fprintf(stderr, "The --view window must be inside the world, and "
+            "have at least as many rows and cols as the frame\n");
+      exit(1);
+   }
+}  /* Check_args */
 
-   srandom(1);
-   for (i = 0; i < m; i++)
-      for (j = 0; j < n; j++)
-         if (random()/((double) RAND_MAX) <= prob) {
-            w1[i*n + j] = LIVE;
-#           ifdef DEBUG
-            live_count++;
-#           endif
-         } else {
-            w1[i*n + j] = DEAD;
-         }
+/*---------------------------------------------------------------------
+ * Function:   Block_range
+ * Purpose:    Split total items into parts nearly equal ranges, and
+ *             find range idx.  The first total % parts ranges get one
+ *             extra item, so no item is left over.
+ * In args:    total, parts, idx
+ * Out args:   start_p, end_p:  range idx is *start_p .. *end_p - 1
+ */
+void Block_range(int total, int parts, int idx, int* start_p, int* end_p) {
+   int quotient = total/parts;
+   int remainder = total % parts;
 
-#  ifdef DEBUG
-         printf("Live count = %d, request prob = %f, actual prob = %f\n",
-            live_count, prob, ((double) live_count)/(m*n));
-#  endif
-}  /* Gen_world */
+   *start_p = idx*quotient + (idx < remainder ? idx : remainder);
+   *end_p = *start_p + quotient + (idx < remainder ? 1 : 0);
+}  /* Block_range */
 
 /*---------------------------------------------------------------------
- * Function:     Play_life
- * Purpose:      Play Conway's game of life.  (See header doc)
- * In args:      rank   
+ * Function:   Make_tiles
+ * Purpose:    Cut the world into tiles and give them to the threads
+ * Global var: In:  r, s, m, units, decomp_strip, tile_rows, tile_cols
+ *             Out:  tiles, first_tile
  *
+ * Note:       The threads form a grid of thread_rows x thread_cols:
+ *             r x s for block decomposition, r*s x 1 for strips.
+ *             Tile rows are split evenly among the thread rows, and
+ *             tile cols among the thread cols, so each thread gets a
+ *             block of tiles.  Rows and units are split evenly among
+ *             the tiles the same way.  Without --tiles there is one
+ *             tile per thread, or STEAL_TILES x STEAL_TILES tiles per
+ *             thread for the work-stealing and pipeline schedulers, so
+ *             there is something to steal, or to run ahead.  A
+ *             thread whose block is empty (when there are more threads
+ *             than rows, say) gets no tiles.  The tiles are stored
+ *             thread by thread.  Tile columns are cut on cache lines
+ *             where there are enough of them, so that (when a row is a
+ *             whole number of cache lines) threads side by side never
+ *             write the same line.
  */
- void *Play_life(void* rank) {
-   long my_rank = (long) rank;
-   int i, j, count;
-   int local_m = m/r;
-   int local_n = n/s;
-   int start_row = (my_rank/s)*(local_m);
-   int start_col = (my_rank%s)*(local_n);
+void Make_tiles(void) {
+   int thread_rows = decomp_strip ? thread_count : r;
+   int thread_cols = decomp_strip ? 1 : s;
+   int per = sched_steal || sched_pipeline ? STEAL_TILES : 1;
+   int trows = tile_rows > 0 ? tile_rows : per*thread_rows;
+   int tcols = decomp_strip ? 1
+             : (tile_cols > 0 ? tile_cols : per*thread_cols);
+   int rank, ti, tj, ti0, ti1, tj0, tj1, count = 0;
+   int ub, line = 1;
+   Tile* tile;
 
-   while (curr_gen < max_gens) {
-      for (i = start_row; i < start_row+local_m; i++) {
-         for (j = start_col; j < start_col+local_n; j++) {
-            count = Count_nbhrs(w1, m, n, i, j);
-   #        ifdef DEBUG
-            if(my_rank == 0)
-            printf("curr_gen = %d, i = %d, j = %d, count = %d\n",
-               curr_gen, i, j, count);
-   #        endif
-            if (count < 2 || count > 3)
-               w2[i*n + j] = DEAD;
-            else if (count == 2)
-               w2[i*n + j] = w1[i*n + j];
-            else /* count == 3 */
-               w2[i*n + j] = LIVE;
-            if (w2[i*n + j] == LIVE) live_count++;
+   if (trows < thread_rows) trows = thread_rows;
+   if (tcols < thread_cols) tcols = thread_cols;
+   if (trows > m) trows = m;
+   if (tcols > units) tcols = units;
+   if (engine->offset != NULL) {
+      ub = engine->offset(m, n, 0, 1) - engine->offset(m, n, 0, 0);
+      if (ub < CACHE_LINE) line = CACHE_LINE/ub;
+      if ((units + line - 1)/line < tcols) line = 1;
+   }
+
+   tiles = malloc(trows*tcols*sizeof(Tile));
+   first_tile = malloc((thread_count + 1)*sizeof(int));
+   for (rank = 0; rank < thread_count; rank++) {
+      first_tile[rank] = count;
+      Block_range(trows, thread_rows, rank/thread_cols, &ti0, &ti1);
+      Block_range(tcols, thread_cols, rank % thread_cols, &tj0, &tj1);
+      for (ti = ti0; ti < ti1; ti++)
+         for (tj = tj0; tj < tj1; tj++) {
+            tile = &tiles[count++];
+            Block_range(m, trows, ti, &tile->row0, &tile->row1);
+            Block_range((units + line - 1)/line, tcols, tj,
+                  &tile->col0, &tile->col1);
+            tile->col0 *= line;
+            tile->col1 = tile->col1*line < units ? tile->col1*line : units;
+            tile->ti = ti;
+            tile->tj = tj;
          }
-      }
-      Barrier(rank);
-      if(BREAK == 1) break;     
    }
+   first_tile[thread_count] = count;
+   tile_count = count;
 
-   return NULL;
-}  /* Play_life */
-  
+   tile_nbrs = NULL;
+   if (active || sched_pipeline) Find_tile_nbrs(trows, tcols);
+   if (active) {
+      changed[0] = malloc(tile_count);
+      changed[1] = malloc(tile_count);
+      memset(changed[0], 1, tile_count);
+      tile_live = calloc(tile_count, sizeof(long));
+   }
+   if (cycle_max > 0) {
+      tile_hash = malloc(tile_count*sizeof(uint64_t));
+      recent_hash = malloc(cycle_max*sizeof(uint64_t));
+      recent_live = malloc(cycle_max*sizeof(long));
+   }
+
+   if (sched_steal) {
+      tile_queues = aligned_alloc(CACHE_LINE,
+            thread_count*sizeof(Tile_queue));
+      Reset_tile_queues();
+   }
+}  /* Make_tiles */
 
 /*---------------------------------------------------------------------
- * Function:   Print_world
- * Purpose:    Print the current world
- * In args:    title
- *             w1:  current gen
+ * Function:   Find_tile_nbrs
+ * Purpose:    List each tile and its eight neighbors on the torus
+ *             of tiles, for active tracking and the pipeline
+ * In args:    trows, tcols:  size of the grid of tiles
+ * Global var: tiles, tile_count, tile_nbrs
+ *
+ * Note:       Every tile is at least one row by one unit, so the
+ *             cells next to a tile are all in the neighboring tiles.
  */
-void Print_world(char title[], int w1[]) {
-   int i, j;
+void Find_tile_nbrs(int trows, int tcols) {
+   int* grid = malloc(trows*tcols*sizeof(int));
+   int t, di, dj, k;
 
-   printf("%s\n\n", title);
+   for (t = 0; t < tile_count; t++)
+      grid[tiles[t].ti*tcols + tiles[t].tj] = t;
 
-   for (i = 0; i < m; i++) {
-      for (j = 0; j < n; j++)
-         if (w1[i*n + j] == LIVE)
-            printf("%c", LIVE_IO);
-         else
-            printf("%c", DEAD_IO);
-     printf("\n");
+   tile_nbrs = malloc(9*tile_count*sizeof(int));
+   for (t = 0; t < tile_count; t++) {
+      k = 0;
+      for (di = -1; di <= 1; di++)
+         for (dj = -1; dj <= 1; dj++)
+            tile_nbrs[9*t + k++] =
+               grid[((tiles[t].ti + di + trows) % trows)*tcols
+                  + (tiles[t].tj + dj + tcols) % tcols];
    }
-
-   printf("-------------\n");
-}  /* Print_world */
+   free(grid);
+}  /* Find_tile_nbrs */
 
 /*---------------------------------------------------------------------
- * Function:   Count_nbhrs
- * Purpose:    Count the number of living nbhrs of the cell (i,j)
- * In args:    w1:  current world
- *             m:   number of rows in world
- *             n:   number of cols in world
- *             i:   row number of current cell
- *             j:   col number of current cell
- * Ret val:    The number of neighboring cells with living neighbors
+ * Function:   Reset_tile_queues
+ * Purpose:    Give every thread its own tiles back for the next
+ *             generation of the work-stealing scheduler
+ * Global var: tile_queues, first_tile
  *
- * Note:       Since the top row of cells is adjacent to the bottom
- *             row, and since the left col of cells is adjacent to the
- *             right col, in a very small world, it's possible to
- *             count a cell as a neighbor twice.  So we assume that
- *             m and n are at least 3.
+ * Note:       Called before the threads start, and by the serial
+ *             thread at the barrier, so no thread is taking tiles.
  */
-int Count_nbhrs(int* w1, int m, int n, int i, int j) {
-   int i1, j1, i2, j2;
-   int count = 0;
-
-   for (i1 = i-1; i1 <= i+1; i1++)
-      for (j1 = j-1; j1 <= j+1; j1++) {
-         i2 = (i1 + m) % m;
-         j2 = (j1 + n) % n;
-         count += w1[i2*n + j2];
-      }
-   count -= w1[i*n + j];
+void Reset_tile_queues(void) {
+   int rank;
 
-   return count;
-}  /* Count_nbhrs */
+   for (rank = 0; rank < thread_count; rank++)
+      atomic_store_explicit(&tile_queues[rank].range,
+            (uint64_t) first_tile[rank] << 32 | first_tile[rank+1],
+            memory_order_relaxed);
+}  /* Reset_tile_queues */
 
-/*-------------------------------------------------------------------
- * Function:    Barrier
- * Purpose:     Run BARRIER_COUNT barriers
- * In arg:      rank
- * Global var:  thread_count, barrier_thread_count, barrier_mutex,
- *              ok_to_proceed
+/*---------------------------------------------------------------------
+ * Function:   Take_tile
+ * Purpose:    Take a tile from the front (the owner) or the back
+ *             (a thief) of a thread's queue
+ * In args:    queue
+ *             front:  1 for the front, 0 for the back
+ * Ret val:    The tile, or -1 if the queue is empty
  */
-void *Barrier(void* rank) {
-   int *tmp;
-   char title[MAX_TITLE];
+static int Take_tile(Tile_queue* queue, int front) {
+   uint64_t range = atomic_load_explicit(&queue->range, memory_order_relaxed);
+   uint32_t head, tail;
 
-   pthread_mutex_lock(&barrier_mutex);
-   barrier_thread_count++;
-   if (barrier_thread_count == thread_count) {
-      tmp = w1;
-      w1 = w2;
-      w2 = tmp;
-      curr_gen++;
-
-      if(live_count > 0){
-         sprintf(title, "Generation %d:", curr_gen);
-         Print_world(title, w1);
+   while (1) {
+      head = range >> 32;
+      tail = (uint32_t) range;
+      if (head >= tail) return -1;
+      if (front) {
+         if (atomic_compare_exchange_weak(&queue->range, &range,
+                  (uint64_t) (head + 1) << 32 | tail))
+            return head;
       } else {
-         BREAK = 1;
+         if (atomic_compare_exchange_weak(&queue->range, &range,
+                  (uint64_t) head << 32 | (tail - 1)))
+            return tail - 1;
       }
+   }
+}  /* Take_tile */
 
-      live_count = 0;      
-      barrier_thread_count = 0;
+/*---------------------------------------------------------------------
+ * Function:   Next_tile
+ * Purpose:    Find the next tile for a thread of the work-stealing
+ *             scheduler:  the front of its own queue while there is
+ *             one, then the back of the other threads' queues
+ * In arg:     rank
+ * Ret val:    The tile, or -1 if every tile of the generation has
+ *             been taken
+ *
+ * Note:       The owner walks its tiles in order and thieves take
+ *             them from the far end, so a thread mostly touches rows
+ *             next to the ones it just did.
+ */
+int Next_tile(long rank) {
+   int t, victim;
+
+   if ((t = Take_tile(&tile_queues[rank], 1)) >= 0) return t;
+   for (victim = (rank + 1) % thread_count; victim != rank;
+         victim = (victim + 1) % thread_count)
+      if ((t = Take_tile(&tile_queues[victim], 0)) >= 0) return t;
+   return -1;
+}  /* Next_tile */
+
+/*---------------------------------------------------------------------
+ * Function:   Get_output_mode
+ * Purpose:    Parse the value of --output:  all, final, none, or a
+ *             number k to print every k-th generation
+ * In args:    val, prog_name
+ * Global var: output_mode, output_every
+ */
+void Get_output_mode(const char val[], char prog_name[]) {
+   if (strcmp(val, "all") == 0) {
+      output_mode = OUTPUT_ALL;
+   } else if (strcmp(val, "final") == 0) {
+      output_mode = OUTPUT_FINAL;
+   } else if (strcmp(val, "none") == 0) {
+      output_mode = OUTPUT_NONE;
+   } else {
+      output_mode = OUTPUT_EVERY;
+      output_every = strtol(val, NULL, 10);
+      if (output_every <= 0) Usage(prog_name);
+   }
+}  /* Get_output_mode */
+
+/*---------------------------------------------------------------------
+ * Function:   Parse_rule
+ * Purpose:    Turn a rule string into the bits of RULE_NEXT
+ * In arg:     str:  "B36/S23" (either way round, in either case),
+ *                the old "23/36" (survival/birth), or the name of
+ *                one of the common rules
+ * Out arg:    rule_p
+ * Ret val:    1 if str is a rule, 0 if it isn't, or if it has B0
+ *
+ * Note:       B0 is refused:  with it an empty world fills, and
+ *             every engine, like the torus, assumes empty space
+ *             stays empty.
+ */
+int Parse_rule(const char str[], uint32_t* rule_p) {
+   uint32_t birth = 0, survive = 0, *part;
+   const char* p = str;
+   int slash = 0;
+
+   if (strcmp(str, "life") == 0) str = "B3/S23";
+   else if (strcmp(str, "highlife") == 0) str = "B36/S23";
+   else if (strcmp(str, "daynight") == 0) str = "B3678/S34678";
+   p = str;
+
+   part = strchr(str, 'B') == NULL && strchr(str, 'b') == NULL
+      ? &survive : &birth;
+   for (; *p != '\0'; p++) {
+      if (*p == 'B' || *p == 'b') {
+         part = &birth;
+      } else if (*p == 'S' || *p == 's') {
+         part = &survive;
+      } else if (*p == '/') {
+         if (slash++ > 0) return 0;
+         if (part == &survive && strchr(str, 'S') == NULL
+               && strchr(str, 's') == NULL)
+            part = &birth;
+      } else if (*p >= '0' && *p <= '8') {
+         *part |= 1 << (*p - '0');
+      } else {
+         return 0;
+      }
+   }
+   if (birth & 1) return 0;
+   *rule_p = birth | survive << 9;
+   return 1;
+}  /* Parse_rule */
+
+/*---------------------------------------------------------------------
+ * Function:   Rule_name
+ * Purpose:    Write a rule the standard way, "B36/S23", so that
+ *             equal rules have equal names
+ * In arg:     rule
+ * Out arg:    name:  room for MAX_RULE chars
+ */
+void Rule_name(uint32_t rule, char name[]) {
+   int k;
+
+   *name++ = 'B';
+   for (k = 0; k <= 8; k++)
+      if (RULE_NEXT(rule, 0, k)) *name++ = '0' + k;
+   *name++ = '/';
+   *name++ = 'S';
+   for (k = 0; k <= 8; k++)
+      if (RULE_NEXT(rule, 1, k)) *name++ = '0' + k;
+   *name = '\0';
+}  /* Rule_name */
+
+/*---------------------------------------------------------------------
+ * Function:   Find_engine
+ * Purpose:    Look up an engine by name
+ * In arg:     name
+ * Ret val:    The engine, or NULL if there is no engine called name
+ */
+const Engine* Find_engine(const char name[]) {
+   int e;
+
+   for (e = 0; e < sizeof(engines)/sizeof(engines[0]); e++)
+      if (strcmp(engines[e].name, name) == 0)
+         return &engines[e];
+   return NULL;
+}  /* Find_engine */
+
+/*---------------------------------------------------------------------
+ * Function:   Select_kernel
+ * Purpose:    Choose the update kernel for an engine
+ * In args:    engine
+ *             name:  "scalar" for the engine's own kernel, "auto" for
+ *                the widest SIMD kernel this host supports, or the
+ *                name of a particular SIMD kernel
+ * Ret val:    The kernel, or NULL if the named kernel is unknown or
+ *             the host doesn't support it
+ *
+ * Note:       The SIMD kernels are compiled with target attributes,
+ *             so a single binary carries all of them, and CPUID (or
+ *             the ARM HWCAPs) decides which ones may run.
+ */
+Update_fn* Select_kernel(const Engine* engine, const char name[]) {
+   const Kernel* k;
+   int is_auto = strcmp(name, "auto") == 0;
+
+   if (engine->update == NULL) return NULL;
+   if (strcmp(name, "scalar") == 0) return engine->update;
+   for (k = kernels; k->name != NULL; k++)
+      if (strcmp(k->engine, engine->name) == 0
+            && (is_auto || strcmp(k->name, name) == 0))
+         if (k->supported())
+            return k->update;
+   return is_auto ? engine->update : NULL;
+}  /* Select_kernel */
+
+/*---------------------------------------------------------------------
+ * Function:   Make_world
+ * Purpose:    Make generation 0, from stdin ('i'), at random ('g'),
+ *             or empty ('e'), and paste the --pattern files into it.
+ *             With --restore, read the checkpoint instead.
+ * In args:    ig
+ *             pool:  threads to generate the world with, or NULL
+ * Out arg:    w1
+ */
+void Make_world(char ig, void* w1, Pool* pool) {
+   char* row;
+   int i;
+
+   if (restore_file != NULL) {
+      Restore_world(w1);
+   } else if (ig == 'i') {
+      Read_world("Enter generation 0", w1, m, n);
+   } else if (ig == 'e') {
+      row = malloc(n);
+      for (i = 0; i < m; i++) {
+         memset(row, DEAD, n);
+         live_count += Store_world_row(w1, m, n, i, row);
+      }
+      free(row);
+   } else {
+      Gen_world("What's the probability that a cell is alive?", w1, m, n,
+            pool);
+   }
+}  /* Make_world */
+
+/*---------------------------------------------------------------------
+ * Function:   Read_world
+ * Purpose:    Get generation 0 from the user
+ * In args:    prompt
+ *             m:  number of rows in visible world
+ *             n:  number of cols in visible world
+ * Out arg:    w1:  stores generation 0
+ * Global var: live_count:  number of live cells in generation 0
+ *
+ * Note:       Each row is n chars and an end of line char, read a
+ *             whole row at a time through a large stdin buffer.  A
+ *             row that's cut short by the end of the input is dead
+ *             from there on.
+ */
+ void Read_world(char prompt[], void* w1, int m, int n) {
+   int i, j;
+   size_t got;
+   char* line = malloc(n + 1);
+   char* row = malloc(n);
+
+   setvbuf(stdin, NULL, _IOFBF, INPUT_BUF);
+   printf("%s\n", prompt);
+   for (i = 0; i < m; i++) {
+      got = fread(line, 1, n + 1, stdin);
+      for (j = 0; j < n; j++)
+         row[j] = j < got && line[j] == LIVE_IO ? LIVE : DEAD;
+      live_count += Store_world_row(w1, m, n, i, row);
+   }
+   free(line);
+   free(row);
+}  /* Read_world */
+
+/*---------------------------------------------------------------------
+ * Function:   Gen_world
+ * Purpose:    Use a random number generator to create generation 0 
+ * In args:    prompt
+ *             m:  number of rows in visible world
+ *             n:  number of cols in visible world
+ *             pool:  the threads, or NULL to generate it serially
+ * Out arg:    w1:  stores generation 0
+ * Global var: live_count:  number of live cells in generation 0
+ *
+ * Note:       Cell (i,j) is alive if its number from Philox, keyed by
+ *             the seed, is below the threshold, so the world is the
+ *             same however it's split among the threads.  Each
+ *             thread stores its own rows:  the engines with a pool
+ *             store whole rows independently.
+ */
+void Gen_world(char prompt[], void* w1, int m, int n, Pool* pool) {
+   int rank;
+
+   Get_probability(prompt);
+   if (pool == NULL) {
+      live_count += Gen_rows(w1, 0, m);
+   } else {
+      Pool_run(pool, Gen_thread);
+      for (rank = 0; rank < thread_count; rank++)
+         live_count += thread_live[rank].value;
+   }
+
+#  ifdef DEBUG
+         printf("Live count = %ld, request prob = %f, actual prob = %f\n",
+            live_count, gen_threshold/4294967296.0,
+            ((double) live_count)/((double) m*n));
+#  endif
+}  /* Gen_world */
+
+/*---------------------------------------------------------------------
+ * Function:   Get_probability
+ * Purpose:    Get the probability that a cell is alive from the
+ *             user, and turn it into gen_threshold
+ * In arg:     prompt
+ * Global var: gen_threshold
+ *
+ * Note:       A --bench run has already set gen_threshold from its
+ *             density.
+ */
+void Get_probability(char prompt[]) {
+   double prob;
+
+   if (bench_format != NULL) return;
+   printf("%s\n", prompt);
+   scanf("%lf", &prob);
+   gen_threshold = Threshold(prob);
+}  /* Get_probability */
+
+/*---------------------------------------------------------------------
+ * Function:   Threshold
+ * Purpose:    Turn the probability that a cell is alive into the
+ *             threshold of its 32-bit random number
+ */
+uint64_t Threshold(double prob) {
+   if (prob <= 0)
+      return 0;
+   else if (prob >= 1)
+      return 1ULL << 32;
+   else
+      return prob*4294967296.0;
+}  /* Threshold */
+
+/*---------------------------------------------------------------------
+ * Function:   Gen_thread
+ * Purpose:    Thread function that generates a block of rows of
+ *             generation 0
+ * In arg:     rank
+ * Global var: w1, thread_live:  its population out
+ */
+void* Gen_thread(void* rank) {
+   long my_rank = (long) rank;
+   int i0, i1;
+
+   Block_range(m, thread_count, my_rank, &i0, &i1);
+   thread_live[my_rank].value = Gen_rows(w1, i0, i1);
+   return NULL;
+}  /* Gen_thread */
+
+/*---------------------------------------------------------------------
+ * Function:   Gen_rows
+ * Purpose:    Generate rows i0 .. i1-1 of generation 0, paste the
+ *             patterns into them, and store them
+ * In args:    i0, i1
+ * Out arg:    w1
+ * Ret val:    The number of live cells in the rows
+ */
+long Gen_rows(void* w1, int i0, int i1) {
+   char* row = malloc(n);
+   long live = 0;
+   int i;
+
+   for (i = i0; i < i1; i++) {
+      Gen_cells(seed, gen_threshold, i, 0, n, row);
+      live += Store_world_row(w1, m, n, i, row);
+   }
+   free(row);
+   return live;
+}  /* Gen_rows */
+
+/*---------------------------------------------------------------------
+ * Function:   Gen_cells
+ * Purpose:    Generate cells j0 .. j1-1 of row i of generation 0
+ * In args:    key:  the seed
+ *             threshold:  a cell is alive if its number is below it
+ *             i, j0, j1
+ * Out arg:    row:  row[k] is cell j0 + k
+ *
+ * Note:       Philox turns the counter (j/4, i) into four 32-bit
+ *             numbers, for cells j/4*4 .. j/4*4 + 3.
+ */
+void Gen_cells(uint64_t key, uint64_t threshold, int i, int j0, int j1,
+      char row[]) {
+   uint32_t x[4];
+   int j, k;
+
+   for (j = j0 - j0 % 4; j < j1; j += 4) {
+      x[0] = j/4;
+      x[1] = i;
+      x[2] = x[3] = 0;
+      Philox(x, key);
+      for (k = 0; k < 4; k++)
+         if (j + k >= j0 && j + k < j1)
+            row[j + k - j0] = x[k] < threshold ? LIVE : DEAD;
+   }
+}  /* Gen_cells */
+
+/*---------------------------------------------------------------------
+ * Function:   Philox
+ * Purpose:    The Philox4x32-10 counter-based random number
+ *             generator of Salmon et al., "Parallel random numbers:
+ *             as easy as 1, 2, 3" (SC 2011)
+ * In arg:     key
+ * In/out arg: ctr:  in, the counter; out, four random numbers
+ */
+void Philox(uint32_t ctr[4], uint64_t key) {
+   uint32_t k0 = (uint32_t) key, k1 = (uint32_t) (key >> 32);
+   uint64_t p0, p1;
+   int round;
+
+   for (round = 0; round < 10; round++) {
+      p0 = (uint64_t) 0xD2511F53 * ctr[0];
+      p1 = (uint64_t) 0xCD9E8D57 * ctr[2];
+      ctr[0] = (uint32_t) (p1 >> 32) ^ ctr[1] ^ k0;
+      ctr[1] = (uint32_t) p1;
+      ctr[2] = (uint32_t) (p0 >> 32) ^ ctr[3] ^ k1;
+      ctr[3] = (uint32_t) p0;
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+   }
+}  /* Philox */
+
+/*---------------------------------------------------------------------
+ * Function:   Store_world_row
+ * Purpose:    Paste the patterns into row i of generation 0, count
+ *             its live cells, and give it to the engine
+ * In args:    m, n, i
+ * In/out arg: row
+ * Out arg:    w1
+ * Ret val:    The number of live cells in the row
+ *
+ * Note:       Different rows can be stored at the same time, except
+ *             by the sparse engine.
+ */
+long Store_world_row(void* w1, int m, int n, int i, char row[]) {
+   long live = 0;
+   int j;
+
+   Paste_patterns(m, n, i, 0, n, row);
+   for (j = 0; j < n; j++)
+      if (row[j] == LIVE) live++;
+   engine->store_row(w1, m, n, i, row);
+   return live;
+}  /* Store_world_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Add_pattern
+ * Purpose:    Read the pattern named by a --pattern option
+ * In args:    arg:  file, or file@row,col
+ *             prog_name
+ * Global var: patterns, pattern_count
+ *
+ * Note:       Without @row,col the pattern goes in the middle of
+ *             the world.  The position of a pattern that's bigger
+ *             than the world may be negative.
+ */
+void Add_pattern(char arg[], char prog_name[]) {
+   Pattern* pat = &patterns[pattern_count];
+   char* at = strrchr(arg, '@');
+   char* end;
+
+   if (pattern_count == MAX_PATTERNS) {
+      fprintf(stderr, "At most %d --pattern options\n", MAX_PATTERNS);
+      exit(1);
+   }
+   pat->file = arg;
+   if (at != NULL) {
+      pat->row = strtol(at + 1, &end, 10);
+      if (*end != ',') Usage(prog_name);
+      pat->col = strtol(end + 1, &end, 10);
+      if (*end != '\0') Usage(prog_name);
+      *at = '\0';
+   }
+   Load_pattern(pat);
+   if (at == NULL) {
+      pat->row = (m - pat->rows)/2;
+      pat->col = (n - pat->cols)/2;
+   }
+   pattern_count++;
+}  /* Add_pattern */
+
+/*---------------------------------------------------------------------
+ * Function:   Load_pattern
+ * Purpose:    Map a pattern file, and parse it as RLE or plaintext
+ * In/out arg: pat:  in:  file; out:  rows, cols, cells
+ *
+ * Note:       A file ending in .rle is RLE, and one ending in
+ *             .cells is plaintext.  Otherwise it's RLE if its first
+ *             line starts with '#' or 'x', as an RLE file's comments
+ *             and header do.
+ */
+void Load_pattern(Pattern* pat) {
+   size_t size, len = strlen(pat->file);
+   const char* text = Map_file(pat->file, &size);
+   int rle;
+
+   if (len > 4 && strcmp(pat->file + len - 4, ".rle") == 0)
+      rle = 1;
+   else if (len > 6 && strcmp(pat->file + len - 6, ".cells") == 0)
+      rle = 0;
+   else
+      rle = size > 0 && (text[0] == '#' || text[0] == 'x');
+   if (rle)
+      Parse_rle(pat, text, text + size);
+   else
+      Parse_cells(pat, text, text + size);
+   if (size > 0) munmap((void*) text, size);
+}  /* Load_pattern */
+
+/*---------------------------------------------------------------------
+ * Function:   Map_file
+ * Purpose:    Map a whole file into memory, read only
+ * In arg:     file
+ * Out arg:    size_p:  its size
+ * Ret val:    The file's contents (NULL if it's empty), which the
+ *             caller unmaps
+ */
+const char* Map_file(const char file[], size_t* size_p) {
+   struct stat st;
+   void* text;
+   int fd = open(file, O_RDONLY);
+
+   if (fd < 0 || fstat(fd, &st) != 0) {
+      fprintf(stderr, "Can't read %s\n", file);
+      exit(1);
+   }
+   *size_p = st.st_size;
+   if (st.st_size == 0) {
+      close(fd);
+      return NULL;
+   }
+   text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (text == MAP_FAILED) {
+      fprintf(stderr, "Can't map %s\n", file);
+      exit(1);
+   }
+   madvise(text, st.st_size, MADV_SEQUENTIAL);
+   return text;
+}  /* Map_file */
+
+/*---------------------------------------------------------------------
+ * Function:   Parse_rle
+ * Purpose:    Parse an RLE pattern
+ * In args:    text, end:  the file is text .. end - 1
+ * Out arg:    pat:  rows, cols, cells
+ *
+ * Note:       After the '#' comment lines comes the header,
+ *             "x = cols, y = rows" (and maybe ", rule = ..."), and
+ *             then runs of cells:  an optional count, and 'b' for
+ *             dead cells, 'o' (or any other letter) for live ones,
+ *             or '$' for the end of a row.  '!' ends the pattern.
+ *             Cells outside of cols x rows are dropped.  Only the
+ *             first RLE_HEADER - 1 chars of the header are read.
+ */
+void Parse_rle(Pattern* pat, const char* text, const char* end) {
+   const char *p = text, *eol;
+   char header[RLE_HEADER];
+   long count, i = 0, j = 0, k;
+   int rows, cols;
+   size_t len;
+
+   while (p < end && *p == '#')
+      while (p < end && *p++ != '\n')
+         ;
+   /* The mapping isn't NUL terminated, so sscanf gets a copy */
+   for (eol = p; eol < end && *eol != '\n'; eol++)
+      ;
+   len = eol - p < RLE_HEADER ? eol - p : RLE_HEADER - 1;
+   memcpy(header, p, len);
+   header[len] = '\0';
+   if (sscanf(header, " x = %d , y = %d", &cols, &rows) != 2
+         || rows <= 0 || cols <= 0) {
+      fprintf(stderr, "%s:  no \"x = cols, y = rows\" header\n",
+            pat->file);
+      exit(1);
+   }
+   while (p < end && *p++ != '\n')
+      ;
+   pat->rows = rows;
+   pat->cols = cols;
+   pat->cells = calloc((size_t) rows*cols, 1);
+
+   while (p < end && *p != '!') {
+      count = 1;
+      if (*p >= '0' && *p <= '9') {
+         count = 0;
+         while (p < end && *p >= '0' && *p <= '9')
+            count = 10*count + *p++ - '0';
+         if (p == end) break;
+      }
+      if (*p == '$') {
+         i += count;
+         j = 0;
+      } else if (*p == 'b' || *p == '.') {
+         j += count;
+      } else if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) {
+         for (k = 0; k < count; k++, j++)
+            if (i < rows && j < cols)
+               pat->cells[i*cols + j] = LIVE;
+      }
+      p++;
+   }
+}  /* Parse_rle */
+
+/*---------------------------------------------------------------------
+ * Function:   Parse_cells
+ * Purpose:    Parse a plaintext (.cells) pattern
+ * In args:    text, end:  the file is text .. end - 1
+ * Out arg:    pat:  rows, cols, cells
+ *
+ * Note:       Lines that start with '!' are comments.  Every other
+ *             line is a row, with 'O' (or '*', or 'X') for a live
+ *             cell, and anything else for a dead one.  The pattern
+ *             is as wide as its longest row.
+ */
+void Parse_cells(Pattern* pat, const char* text, const char* end) {
+   const char *p, *line;
+   long i, j, len;
+
+   pat->rows = pat->cols = 0;
+   for (p = text; p < end; p++) {
+      for (line = p; p < end && *p != '\n'; p++)
+         ;
+      len = p - line;
+      if (len > 0 && line[len-1] == '\r') len--;
+      if (len > 0 && line[0] == '!') continue;
+      pat->rows++;
+      if (len > pat->cols) pat->cols = len;
+   }
+   if (pat->rows == 0 || pat->cols == 0) {
+      fprintf(stderr, "%s:  the pattern is empty\n", pat->file);
+      exit(1);
+   }
+   pat->cells = calloc((size_t) pat->rows*pat->cols, 1);
+
+   i = 0;
+   for (p = text; p < end; p++) {
+      for (line = p; p < end && *p != '\n'; p++)
+         ;
+      if (p > line && line[0] == '!') continue;
+      for (j = 0; j < p - line; j++)
+         if (line[j] == 'O' || line[j] == '*' || line[j] == 'X')
+            pat->cells[i*pat->cols + j] = LIVE;
+      i++;
+   }
+}  /* Parse_cells */
+
+/*---------------------------------------------------------------------
+ * Function:   Paste_patterns
+ * Purpose:    Copy the rows of the patterns that land on cells
+ *             j0 .. j1-1 of row i of the world into row
+ * In args:    m, n, i, j0, j1
+ * In/out arg: row:  row[k] is cell j0 + k
+ * Global var: patterns, pattern_count, plane
+ *
+ * Note:       Each pattern replaces the cells under it, dead or
+ *             alive, in the order they were given.  On the torus a
+ *             pattern wraps around the edges (and a pattern bigger
+ *             than the world overlaps itself); on the plane the
+ *             parts outside of the window are cut off.
+ */
+void Paste_patterns(int m, int n, int i, int j0, int j1, char row[]) {
+   const Pattern* pat;
+   const unsigned char* cells;
+   long pi, pj, j;
+   int p;
+
+   for (p = 0; p < pattern_count; p++) {
+      pat = &patterns[p];
+      pi = plane ? i - pat->row : ((i - pat->row) % m + m) % m;
+      for (; pi >= 0 && pi < pat->rows; pi += plane ? pat->rows : m) {
+         cells = pat->cells + pi*pat->cols;
+         for (pj = 0; pj < pat->cols; pj++) {
+            j = pat->col + pj;
+            if (!plane) j = (j % n + n) % n;
+            if (j >= j0 && j < j1) row[j - j0] = cells[pj];
+         }
+      }
+   }
+}  /* Paste_patterns */
+
+/*---------------------------------------------------------------------
+ * Function:     Play_life
+ * Purpose:      Play Conway's game of life.  (See header doc)
+ * In args:      rank   
+ * Global var:   tiles, first_tile:  thread rank updates tiles
+ *                  first_tile[rank] .. first_tile[rank+1]-1, or with
+ *                  sched_steal, starts with those tiles and then
+ *                  steals tiles the other threads haven't started
+ *                  thread_live:  each thread leaves the number of live
+ *                  cells in its tiles on its own cache line, and
+ *                  Next_generation adds them up
+ *                  halo_depth:  if it's more than 1, each tile is
+ *                  advanced block_steps generations per barrier by
+ *                  Deep_tile, in scratch worlds of the thread's own,
+ *                  and the populations go in block_live
+ *                  view_due:  each thread adds the tiles it just
+ *                  computed to the --view frame (see View_tile)
+ *
+ */
+ void *Play_life(void* rank) {
+   long my_rank = (long) rank;
+   long live;
+   long* my_live = NULL;
+   unsigned char* deep[2] = {NULL, NULL};
+   unsigned char* view_cells = view_h > 0 ? malloc(n) : NULL;
+   int t;
+
+   PROF_THREAD(my_rank);
+   if (halo_depth > 1) {
+      my_live = block_live + my_rank*block_stride;
+      deep[0] = malloc(deep_size);
+      deep[1] = malloc(deep_size);
+   }
+
+   while (curr_gen < max_gens) {
+      live = 0;
+      if (halo_depth > 1) memset(my_live, 0, halo_depth*sizeof(long));
+      if (sched_steal) {
+         while ((t = Next_tile(my_rank)) >= 0) {
+            PROF_START(t0);
+            if (halo_depth > 1) Deep_tile(t, deep, my_live);
+            else live += Update_tile(t);
+            if (view_due) View_tile(t, view_cells);
+            PROF_STOP(PROF_COMPUTE, t0, curr_gen + 1, t);
+         }
+      } else {
+         for (t = first_tile[my_rank]; t < first_tile[my_rank+1]; t++) {
+            PROF_START(t0);
+            if (halo_depth > 1) Deep_tile(t, deep, my_live);
+            else live += Update_tile(t);
+            if (view_due) View_tile(t, view_cells);
+            PROF_STOP(PROF_COMPUTE, t0, curr_gen + 1, t);
+         }
+      }
+      thread_live[my_rank].value = live;
+      Barrier(rank);
+      if(BREAK == 1) break;     
+   }
+
+   free(deep[0]);
+   free(deep[1]);
+   free(view_cells);
+   return NULL;
+}  /* Play_life */
+
+/*---------------------------------------------------------------------
+ * Function:     Update_tile
+ * Purpose:      Compute tile t of the next generation
+ * In arg:       t
+ * Ret val:      Number of live cells in the tile
+ * Global var:   active, changed, tile_live, tile_nbrs, cycle_max,
+ *               tile_hash
+ *
+ * Note:         With active tracking, a tile is only computed if it
+ *               or one of its eight neighbors changed in the last
+ *               generation.  Otherwise its next generation is the
+ *               same as its current one, and w2 already holds it:
+ *               either the tile was computed last time and found not
+ *               to change, so w1 and w2 agree, or it was skipped last
+ *               time too, and they agreed then.  With --cycles, the
+ *               thread that computes a tile also hashes it, and a
+ *               tile that didn't change keeps its hash.
+ */
+long Update_tile(int t) {
+   const Tile* tile = &tiles[t];
+   int k, needed;
+   long live;
+
+   if (!active) {
+      live = Step_tile(w1, w2, tile);
+      if (cycle_max > 0) tile_hash[t] = Hash_tile(w2, tile, t);
+      return live;
+   }
+
+   needed = 0;
+   for (k = 0; k < 9 && !needed; k++)
+      needed = changed[0][tile_nbrs[9*t + k]];
+   if (!needed) {
+      changed[1][t] = 0;
+      return tile_live[t];
+   }
+   tile_live[t] = live = Step_tile(w1, w2, tile);
+   changed[1][t] = Tile_differs(w1, w2, tile);
+   if (cycle_max > 0 && changed[1][t]) tile_hash[t] = Hash_tile(w2, tile, t);
+   return live;
+}  /* Update_tile */
+
+/*---------------------------------------------------------------------
+ * Function:     Step_tile
+ * Purpose:      Compute a tile of the next generation, and refresh
+ *               the part of the ghost border that copies it
+ * In args:      cur:  current world
+ *               tile
+ * Out arg:      next:  next world
+ * Ret val:      Number of live cells in the tile
+ * Global var:   cache_block
+ *
+ * Note:         A wide tile is stepped a strip of cache_block units at
+ *               a time, so that the three rows the kernel reads stay in
+ *               cache from one row of the strip to the next.
+ */
+long Step_tile(const void* cur, void* next, const Tile* tile) {
+   long live = 0;
+   int c0, c1;
+
+   if (cache_block <= 0) {
+      live = update(cur, next, m, n, tile->row0, tile->row1,
+            tile->col0, tile->col1, rule);
+   } else {
+      for (c0 = tile->col0; c0 < tile->col1; c0 = c1) {
+         c1 = c0 + cache_block < tile->col1 ? c0 + cache_block
+            : tile->col1;
+         live += update(cur, next, m, n, tile->row0, tile->row1, c0, c1,
+               rule);
+      }
+   }
+
+   if (engine->refresh != NULL)
+      engine->refresh(next, m, n, tile->row0, tile->row1,
+            tile->col0, tile->col1);
+   PROF_CELLS(Tile_cells(tile));
+   return live;
+}  /* Step_tile */
+
+/*---------------------------------------------------------------------
+ * Function:     Tune_cache_block
+ * Purpose:      Choose the width of the strips Step_tile steps a tile
+ *               in, by timing a few widths on a band of the world
+ * Ret val:      The width in units, or 0 for whole rows
+ * Global var:   w1, w2, m, n, units, engine, cache_block
+ *
+ * Note:         The widths tried are 8, 32 and 128 KB of a row, which
+ *               keep the band's rows in L1 or L2, against whole rows;
+ *               a strip has to be 5% faster than whole rows to win.
+ *               The band is the first TUNE_ROWS rows of w1, whole, so
+ *               that whole rows are timed at their real width, and it's
+ *               stepped into w2 before generation 1 overwrites it.
+ *               Rows under 16 KB aren't worth cutting up, and aren't
+ *               timed.
+ */
+int Tune_cache_block(void) {
+   const int bytes[] = {8192, 32768, 131072};
+   int ub = engine->offset(m, n, 0, 1) - engine->offset(m, n, 0, 0);
+   Tile band = {0, m < TUNE_ROWS ? m : TUNE_ROWS, 0, units, 0, 0};
+   double t0, t, best_t = 0;
+   int k, rep, width, best = 0;
+
+   if ((long) units*ub < 2*bytes[0]) return 0;
+
+   cache_block = 0;
+   Step_tile(w1, w2, &band);      /* fault in w2's pages */
+   for (k = -1; k < 3; k++) {
+      width = k < 0 ? 0 : bytes[k]/ub;
+      if (width >= band.col1) break;
+      cache_block = width;
+      t = 0;
+      for (rep = 0; rep < TUNE_REPS; rep++) {
+         t0 = Now();
+         Step_tile(w1, w2, &band);
+         if (rep == 0 || Now() - t0 < t) t = Now() - t0;
+      }
+      if (k < 0 || t < 0.95*best_t) {
+         best_t = t;
+         best = width;
+      }
+   }
+
+#  ifdef DEBUG
+   printf("Cache block = %d units\n", best);
+#  endif
+   return best;
+}  /* Tune_cache_block */
+
+/*---------------------------------------------------------------------
+ * Function:     Unit_cells
+ * Purpose:      Find how many cells wide a unit of block columns is
+ * Ret val:      1 for the engines that count in cells, 64 for the
+ *               packed ones, which count in words (the last word of
+ *               a row can be partly empty)
+ * Global var:   units, n
+ */
+int Unit_cells(void) {
+   return units == n ? 1 : 64;
+}  /* Unit_cells */
+
+/*---------------------------------------------------------------------
+ * Function:     Deep_start
+ * Purpose:      Set up temporal blocking:  choose the kernel for the
+ *               scratch worlds and find how big they must be
+ * Global var:   halo_depth, tiles, deep_update, deep_size, block_live,
+ *               block_stride, block_steps
+ *
+ * Note:         Every engine's scratch worlds are halo worlds, one
+ *               byte per cell, so the halo kernels (SIMD included)
+ *               do the stepping.
+ */
+void Deep_start(void) {
+   int per = Unit_cells();
+   int t, rows = 0, cells = 0;
+
+   deep_update = Select_kernel(Find_engine("halo"), kernel_name);
+   if (deep_update == NULL) deep_update = Halo_update;
+
+   for (t = 0; t < tile_count; t++) {
+      if (tiles[t].row1 - tiles[t].row0 > rows)
+         rows = tiles[t].row1 - tiles[t].row0;
+      if ((tiles[t].col1 - tiles[t].col0)*per > cells)
+         cells = (tiles[t].col1 - tiles[t].col0)*per;
+   }
+   deep_size = Halo_world_size(rows + 2*halo_depth, cells + 2*halo_depth);
+
+   block_stride = (halo_depth + CACHE_LINE/sizeof(long) - 1)
+      / (CACHE_LINE/sizeof(long)) * (CACHE_LINE/sizeof(long));
+   block_live = aligned_alloc(CACHE_LINE,
+         thread_count*block_stride*sizeof(long));
+   block_steps = Deep_steps();
+}  /* Deep_start */
+
+/*---------------------------------------------------------------------
+ * Function:     Deep_steps
+ * Purpose:      Find how many generations the next round can cover:
+ *               halo_depth, but no further than the next generation
+ *               that's printed, or max_gens
+ * Ret val:      The number of generations
+ * Global var:   halo_depth, curr_gen, max_gens
+ */
+int Deep_steps(void) {
+   return Gens_to_output(halo_depth);
+}  /* Deep_steps */
+
+/*---------------------------------------------------------------------
+ * Function:     Deep_band
+ * Purpose:      Step a block of a scratch world, if it isn't empty
+ */
+static inline long Deep_band(const unsigned char* cur, unsigned char* next,
+      int bm, int bn, int row0, int row1, int col0, int col1) {
+   if (row0 >= row1 || col0 >= col1) return 0;
+   return deep_update(cur, next, bm, bn, row0, row1, col0, col1, rule);
+}  /* Deep_band */
+
+/*---------------------------------------------------------------------
+ * Function:     Deep_load_row
+ * Purpose:      Copy len cells of row i of the world, starting at
+ *               column j, into cells, wrapping around the torus
+ */
+static void Deep_load_row(const void* w, int i, int j, int len,
+      unsigned char cells[]) {
+   int seg;
+
+   j = (j % n + n) % n;
+   while (len > 0) {
+      seg = len < n - j ? len : n - j;
+      engine->load_cells(w, m, n, i, j, seg, cells);
+      cells += seg;
+      len -= seg;
+      j = 0;
+   }
+}  /* Deep_load_row */
+
+/*---------------------------------------------------------------------
+ * Function:     Deep_tile
+ * Purpose:      Advance tile t block_steps generations, from w1 to
+ *               w2, without looking at any other tile's results
+ * In arg:       t
+ * Scratch:      deep:  two scratch worlds of deep_size bytes
+ * In/out arg:   live:  live[s-1] += the population of the tile s
+ *                  generations on
+ *
+ * Note:         The tile is copied out with a halo d = block_steps
+ *               cells deep.  Generation s is only right up to d - s
+ *               cells from the tile, so each step computes one cell
+ *               less all round, and after d steps the tile itself is
+ *               right.  The halos are computed again by the
+ *               neighboring tiles:  that's the price of having only
+ *               one barrier every d generations.
+ */
+void Deep_tile(int t, unsigned char* deep[2], long live[]) {
+   const Tile* tile = &tiles[t];
+   int d = block_steps;
+   int per = Unit_cells();
+   int c0 = tile->col0*per;
+   int c1 = tile->col1*per < n ? tile->col1*per : n;
+   int bm = tile->row1 - tile->row0 + 2*d;
+   int bn = c1 - c0 + 2*d;
+   size_t stride = bn + 2;
+   const unsigned char* cur;
+   unsigned char* next;
+   int i, st;
+
+   for (i = 0; i < bm; i++)
+      Deep_load_row(w1, ((tile->row0 - d + i) % m + m) % m, c0 - d, bn,
+            deep[0] + (i+1)*stride + 1);
+
+   for (st = 1; st <= d; st++) {
+      cur = deep[(st-1) % 2];
+      next = deep[st % 2];
+      Deep_band(cur, next, bm, bn, st, d, st, bn - st);
+      Deep_band(cur, next, bm, bn, bm - d, bm - st, st, bn - st);
+      Deep_band(cur, next, bm, bn, d, bm - d, st, d);
+      Deep_band(cur, next, bm, bn, d, bm - d, bn - d, bn - st);
+      live[st-1] += deep_update(cur, next, bm, bn, d, bm - d, d, bn - d,
+            rule);
+   }
+
+   PROF_CELLS(d*Tile_cells(tile));
+   next = deep[d % 2];
+   for (i = tile->row0; i < tile->row1; i++)
+      engine->store_cells(w2, m, n, i, c0, c1 - c0,
+            next + (i - tile->row0 + d + 1)*stride + d + 1);
+   if (engine->refresh != NULL)
+      engine->refresh(w2, m, n, tile->row0, tile->row1,
+            tile->col0, tile->col1);
+}  /* Deep_tile */
+
+/*---------------------------------------------------------------------
+ * Function:     Deep_generations
+ * Purpose:      At the barrier after a round of Deep_tile:  add up
+ *               the populations, move curr_gen on, and size the next
+ *               round
+ * Global var:   block_live, block_steps, curr_gen, live_count
+ *
+ * Note:         If the world died during the round, curr_gen is the
+ *               generation it died in.  Dead worlds stay dead, so w1
+ *               is that generation too.
+ */
+void Deep_generations(void) {
+   long live = 0;
+   int st, t;
+
+   for (st = 0; st < block_steps; st++) {
+      live = 0;
+      for (t = 0; t < thread_count; t++)
+         live += block_live[t*block_stride + st];
+      if (live == 0) break;
+   }
+   curr_gen += st < block_steps ? st + 1 : block_steps;
+   live_count = live;
+   block_steps = Deep_steps();
+}  /* Deep_generations */
+
+/*---------------------------------------------------------------------
+ * Function:     Tile_differs
+ * Purpose:      Compare a tile of two worlds
+ * In args:      w1, w2, tile
+ * Ret val:      1 if the tile differs, 0 if it's the same in both
+ */
+int Tile_differs(const void* w1, const void* w2, const Tile* tile) {
+   size_t start, len;
+   int i;
+
+   for (i = tile->row0; i < tile->row1; i++) {
+      start = engine->offset(m, n, i, tile->col0);
+      len = engine->offset(m, n, i, tile->col1) - start;
+      if (memcmp((const char*) w1 + start, (const char*) w2 + start, len))
+         return 1;
+   }
+   return 0;
+}  /* Tile_differs */
+
+/*---------------------------------------------------------------------
+ * Function:     Hash_tile
+ * Purpose:      Hash the cells of a tile of a world
+ * In args:      w, tile
+ *               key:  the index of the tile
+ * Ret val:      The hash, which depends on the key as well as on the
+ *               cells, so that the sum of the hashes of the tiles is
+ *               a hash of the world in which moving a pattern from
+ *               one tile to another changes the sum
+ */
+uint64_t Hash_tile(const void* w, const Tile* tile, uint64_t key) {
+   const unsigned char* p;
+   size_t start, len, k;
+   uint64_t h0 = key + 1, h1 = ~h0;
+   uint64_t word[2];
+   int i;
+
+   /* Two polynomial hashes of alternate words, so that the multiplies
+      don't wait for each other */
+   for (i = tile->row0; i < tile->row1; i++) {
+      start = engine->offset(m, n, i, tile->col0);
+      len = engine->offset(m, n, i, tile->col1) - start;
+      p = (const unsigned char*) w + start;
+      for (k = 0; k + sizeof(word) <= len; k += sizeof(word)) {
+         memcpy(word, p + k, sizeof(word));
+         h0 = h0*0x9E3779B97F4A7C15ULL + word[0];
+         h1 = h1*0xBF58476D1CE4E5B9ULL + word[1];
+      }
+      if (k < len) {
+         word[0] = word[1] = 0;
+         memcpy(word, p + k, len - k);
+         h0 = h0*0x9E3779B97F4A7C15ULL + word[0];
+         h1 = h1*0xBF58476D1CE4E5B9ULL + word[1];
+      }
+   }
+   h0 ^= (h1 ^ (h1 >> 29))*0x94D049BB133111EBULL;
+   return h0 ^ (h0 >> 32);
+}  /* Hash_tile */
+
+/*---------------------------------------------------------------------
+ * Function:     World_hash
+ * Purpose:      Add up the hashes of the tiles of w1
+ * Global var:   tile_hash, tile_count
+ *
+ * Note:         The sum doesn't depend on the order of the tiles, so
+ *               the threads can hash their tiles in any order.
+ */
+uint64_t World_hash(void) {
+   uint64_t h = 0;
+   int t;
+
+   for (t = 0; t < tile_count; t++)
+      h += tile_hash[t];
+   return h;
+}  /* World_hash */
+
+/*---------------------------------------------------------------------
+ * Function:     Find_cycle
+ * Purpose:      Add generation gen to a ring of recent hashes, and
+ *               look for an earlier generation equal to it
+ * In args:      h:  the hash of the world
+ *               gen, live:  the generation and its population
+ *               first:  the first generation in the ring
+ * In/out args:  ring_hash, ring_live:  the hashes and populations of
+ *                  the last cycle_max generations
+ * Ret val:      The smallest period p <= cycle_max for which
+ *               generation gen - p has the same hash and population,
+ *               or 0
+ * Global var:   cycle_max
+ *
+ * Note:         Two different worlds with the same 64-bit hash and
+ *               the same population are possible but very unlikely.
+ */
+int Find_cycle(uint64_t h, long gen, long live, long first,
+      uint64_t ring_hash[], long ring_live[]) {
+   int p, slot;
+
+   for (p = 1; p <= cycle_max && gen - p >= first; p++) {
+      slot = (gen - p) % cycle_max;
+      if (ring_hash[slot] == h && ring_live[slot] == live) break;
+   }
+   slot = gen % cycle_max;
+   ring_hash[slot] = h;
+   ring_live[slot] = live;
+   return p <= cycle_max && gen - p >= first ? p : 0;
+}  /* Find_cycle */
+
+/*---------------------------------------------------------------------
+ * Function:     Batch_run
+ * Purpose:      Play every world of the --batch file to the end, and
+ *               print a table of what became of them
+ * Global var:   batch_file, batch, batch_count, batch_next,
+ *               thread_count
+ *
+ * Note:         The worlds are small and independent, so each thread
+ *               takes whole worlds, one at a time, and plays them by
+ *               itself:  there's no barrier, and no thread waits for
+ *               another until the last world is taken.
+ */
+void Batch_run(void) {
+   Pool* pool;
+   const Batch_world* b;
+   int k;
+
+   Read_batch(batch_file);
+   atomic_store(&batch_next, 0);
+   pool = Pool_create(thread_count);
+   if (pool == NULL) {
+      fprintf(stderr, "Can't start %d threads\n", thread_count);
+      exit(1);
+   }
+   Pool_run(pool, Batch_thread);
+   Pool_destroy(pool);
+
+   printf("world,seed,density,live0,generations,live,end,period\n");
+   for (k = 0; k < batch_count; k++) {
+      b = &batch[k];
+      printf("%d,%llu,%g,%ld,%ld,%ld,%s,%d\n", k,
+            (unsigned long long) b->seed, b->prob, b->live0, b->gens,
+            b->live, b->period > 0 ? "cycle" : b->live == 0 ? "dead"
+            : "max", b->period);
+   }
+   free(batch);
+}  /* Batch_run */
+
+/*---------------------------------------------------------------------
+ * Function:     Read_batch
+ * Purpose:      Read the worlds of a --batch file:  a line
+ *               "seed density" for each, where density is the
+ *               probability that a cell of generation 0 is alive.
+ *               Blank lines and lines that start with '#' are
+ *               skipped.
+ * In arg:       file
+ * Global var:   batch, batch_count (out)
+ */
+void Read_batch(const char file[]) {
+   FILE* fp = fopen(file, "r");
+   char line[256], *p;
+   unsigned long long key;
+   double prob;
+   int size = 1024, lineno = 0;
+
+   if (fp == NULL) {
+      fprintf(stderr, "Can't open %s\n", file);
+      exit(1);
+   }
+   batch = malloc(size*sizeof(Batch_world));
+   batch_count = 0;
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      lineno++;
+      for (p = line; *p == ' ' || *p == '\t'; p++)
+         ;
+      if (*p == '\n' || *p == '\0' || *p == '#') continue;
+      if (sscanf(p, "%llu %lf", &key, &prob) != 2) {
+         fprintf(stderr, "%s:%d:  expected \"seed density\"\n", file,
+               lineno);
+         exit(1);
+      }
+      if (batch_count == size) {
+         size *= 2;
+         batch = realloc(batch, size*sizeof(Batch_world));
+      }
+      memset(&batch[batch_count], 0, sizeof(Batch_world));
+      batch[batch_count].seed = key;
+      batch[batch_count].prob = prob;
+      batch_count++;
+   }
+   fclose(fp);
+}  /* Read_batch */
+
+/*---------------------------------------------------------------------
+ * Function:     Batch_thread
+ * Purpose:      Thread function of --batch:  take worlds until there
+ *               are none left
+ * In arg:       rank
+ * Global var:   batch, batch_count, batch_next, engine, cycle_max
+ */
+void* Batch_thread(void* rank) {
+   size_t size = engine->world_size(m, n);
+   void* w[2];
+   char* row = malloc(n);
+   uint64_t* ring_hash = NULL;
+   long* ring_live = NULL;
+   int k;
+
+   w[0] = World_alloc(size);
+   w[1] = World_alloc(size);
+   if (cycle_max > 0) {
+      ring_hash = malloc(cycle_max*sizeof(uint64_t));
+      ring_live = malloc(cycle_max*sizeof(long));
+   }
+   while ((k = atomic_fetch_add(&batch_next, 1)) < batch_count)
+      Batch_play(&batch[k], w, row, ring_hash, ring_live);
+
+   World_free(w[0], size);
+   World_free(w[1], size);
+   free(row);
+   free(ring_hash);
+   free(ring_live);
+   return NULL;
+}  /* Batch_thread */
+
+/*---------------------------------------------------------------------
+ * Function:     Batch_play
+ * Purpose:      Generate a world of --batch and play it until it dies,
+ *               repeats (with --cycles), or reaches max_gens
+ * In/out arg:   b:  the seed and density in, what became of it out
+ * Scratch:      w:  two worlds of the engine
+ *               row:  n chars
+ *               ring_hash, ring_live:  cycle_max of each
+ * Global var:   engine, update, units, cycle_max, max_gens
+ */
+void Batch_play(Batch_world* b, void* w[2], char row[],
+      uint64_t ring_hash[], long ring_live[]) {
+   Tile whole = {0, m, 0, units, 0, 0};
+   uint64_t threshold = Threshold(b->prob);
+   void* cur = w[0];
+   void* next = w[1];
+   void* tmp;
+   long live = 0, gen = 0;
+   int i, period = 0;
+
+   for (i = 0; i < m; i++) {
+      Gen_cells(b->seed, threshold, i, 0, n, row);
+      live += Store_world_row(cur, m, n, i, row);
+   }
+   if (engine->refresh != NULL) engine->refresh(cur, m, n, 0, m, 0, units);
+   b->live0 = live;
+   if (cycle_max > 0)
+      Find_cycle(Hash_tile(cur, &whole, 0), 0, live, 0,
+            ring_hash, ring_live);
+
+   while (gen < max_gens && live > 0 && period == 0) {
+      live = update(cur, next, m, n, 0, m, 0, units, rule);
+      if (engine->refresh != NULL)
+         engine->refresh(next, m, n, 0, m, 0, units);
+      tmp = cur;
+      cur = next;
+      next = tmp;
+      gen++;
+      if (cycle_max > 0 && live > 0)
+         period = Find_cycle(Hash_tile(cur, &whole, 0), gen, live, 0,
+               ring_hash, ring_live);
+   }
+   b->gens = gen;
+   b->live = live;
+   b->period = period;
+}  /* Batch_play */
+
+/*---------------------------------------------------------------------
+ * Function:   Now
+ * Purpose:    Read the monotonic clock
+ * Ret val:    The time in seconds
+ */
+double Now(void) {
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec*1e-9;
+}  /* Now */
+
+/*---------------------------------------------------------------------
+ * Function:   Bench_stamp
+ * Purpose:    In a --bench run, mark the time curr_gen was reached
+ * Global var: bench_marks, bench_count, bench_cap, curr_gen
+ *
+ * Note:       It's called from the serial step of each engine, so
+ *             only one thread at a time calls it.  Without --bench
+ *             it does nothing.
+ */
+void Bench_stamp(void) {
+   if (bench_marks == NULL || bench_count == bench_cap) return;
+   bench_marks[bench_count].gen = curr_gen;
+   bench_marks[bench_count].time = Now();
+   bench_count++;
+}  /* Bench_stamp */
+
+#ifdef LIFE_PROFILE
+/*---------------------------------------------------------------------
+ * Function:   Tile_cells
+ * Purpose:    Count the cells of a tile
+ */
+long Tile_cells(const Tile* tile) {
+   int per = Unit_cells();
+   int c1 = tile->col1*per < n ? tile->col1*per : n;
+
+   return (long) (tile->row1 - tile->row0)*(c1 - tile->col0*per);
+}  /* Tile_cells */
+
+/*---------------------------------------------------------------------
+ * Function:   Prof_start
+ * Purpose:    Zero the counters of the threads and the writer
+ * Global var: prof, prof_t0, thread_count
+ *
+ * Note:       The counters are only there with -DLIFE_PROFILE.  Each
+ *             thread adds to its own, through prof_me, so there's no
+ *             sharing and no locking; they're only read at the end.
+ */
+void Prof_start(void) {
+   prof = aligned_alloc(CACHE_LINE, (thread_count + 1)*sizeof(Prof_thread));
+   memset(prof, 0, (thread_count + 1)*sizeof(Prof_thread));
+   prof_t0 = Now();
+}  /* Prof_start */
+
+/*---------------------------------------------------------------------
+ * Function:   Prof_add
+ * Purpose:    Add the time from t0 to now to the calling thread's
+ *             phase, and to its --trace timeline
+ * In args:    phase, t0
+ *             gen, tile:  what it was working on (tile -1 for none)
+ * Global var: prof_me, trace_file
+ */
+void Prof_add(int phase, double t0, long gen, int tile) {
+   double t1 = Now();
+   Prof_event* e;
+
+   if (prof_me == NULL) return;
+   prof_me->time[phase] += t1 - t0;
+   if (trace_file == NULL) return;
+   if (prof_me->event_count == prof_me->event_cap) {
+      prof_me->event_cap = prof_me->event_cap > 0
+            ? 2*prof_me->event_cap : PROF_EVENTS;
+      prof_me->events = realloc(prof_me->events,
+            prof_me->event_cap*sizeof(Prof_event));
+   }
+   e = &prof_me->events[prof_me->event_count++];
+   e->t0 = t0;
+   e->t1 = t1;
+   e->gen = gen;
+   e->tile = tile;
+   e->phase = phase;
+}  /* Prof_add */
+
+/*---------------------------------------------------------------------
+ * Function:   Prof_finish
+ * Purpose:    Report the counters, write the --trace file, and free
+ *             them
+ * Global var: prof, trace_file, thread_count
+ */
+void Prof_finish(void) {
+   int k;
+
+   Prof_report();
+   if (trace_file != NULL) Prof_trace(trace_file);
+   for (k = 0; k <= thread_count; k++)
+      free(prof[k].events);
+   free(prof);
+   prof = NULL;
+}  /* Prof_finish */
+
+/*---------------------------------------------------------------------
+ * Function:   Prof_report
+ * Purpose:    Print each thread's compute, wait and serial time and
+ *             its cells, and how unevenly the compute was spread
+ * Global var: prof, prof_t0, thread_count, r, s, decomp_strip
+ *
+ * Note:       The report goes to stderr, so the worlds on stdout are
+ *             unchanged.  Wait is the time at the barrier less the
+ *             serial work done there; with --sched=pipeline it's the
+ *             time spent looking for a tile that's ready.  The
+ *             imbalance is the slowest thread's compute time over
+ *             the mean:  1 is perfect, and with r*c threads it's at
+ *             most r*c.
+ */
+void Prof_report(void) {
+   double total = Now() - prof_t0;
+   double compute, wait, sum = 0, max = 0, waited = 0;
+   char block[32];
+   int k, slowest = 0;
+
+   fprintf(stderr, "Profile of %.3f s (seconds per thread):\n", total);
+   fprintf(stderr, "thread    block    compute       wait     serial"
+         "         cells   Mcells/s\n");
+   for (k = 0; k < thread_count; k++) {
+      compute = prof[k].time[PROF_COMPUTE];
+      wait = prof[k].time[PROF_WAIT] - prof[k].time[PROF_SERIAL];
+      if (decomp_strip)
+         sprintf(block, "%d", k);
+      else
+         sprintf(block, "(%d,%d)", k/s, k % s);
+      fprintf(stderr, "%6d %8s %10.4f %10.4f %10.4f %13ld %10.1f\n", k,
+            block, compute, wait, prof[k].time[PROF_SERIAL],
+            prof[k].cells, compute > 0 ? prof[k].cells/compute/1e6 : 0);
+      sum += compute;
+      waited += wait;
+      if (compute > max) {
+         max = compute;
+         slowest = k;
+      }
+   }
+   fprintf(stderr, "writer %8s %10s %10s %10s   output %.4f\n", "", "",
+         "", "", prof[thread_count].time[PROF_OUTPUT]);
+   if (sum > 0)
+      fprintf(stderr, "Imbalance %.3f:  thread %d computed for %.4f s, "
+            "the mean is %.4f s; the threads waited %.1f%% of the "
+            "time\n", max*thread_count/sum, slowest, max,
+            sum/thread_count, 100*waited/(total*thread_count));
+}  /* Prof_report */
+
+/*---------------------------------------------------------------------
+ * Function:   Prof_trace
+ * Purpose:    Write the threads' timelines as a Chrome trace (JSON
+ *             for chrome://tracing or Perfetto)
+ * In arg:     file
+ * Global var: prof, prof_t0, thread_count
+ *
+ * Note:       Each thread is a track, the writer the last one, with
+ *             a complete ("X") event for each tile it computed, each
+ *             wait at the barrier with the serial work inside it,
+ *             and each frame written.  Times are in microseconds
+ *             from the start of the run.
+ */
+void Prof_trace(const char file[]) {
+   const char* names[PROF_PHASES] = {"compute", "wait", "serial",
+         "output"};
+   const Prof_event* e;
+   FILE* fp = fopen(file, "w");
+   int k;
+   long i;
+
+   if (fp == NULL) {
+      fprintf(stderr, "Can't write the trace %s\n", file);
+      return;
+   }
+   fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+   for (k = 0; k <= thread_count; k++) {
+      if (k < thread_count)
+         fprintf(fp, "{\"name\": \"thread_name\", \"ph\": \"M\", "
+               "\"pid\": 1, \"tid\": %d, \"args\": {\"name\": "
+               "\"thread %d\"}},\n", k, k);
+      else
+         fprintf(fp, "{\"name\": \"thread_name\", \"ph\": \"M\", "
+               "\"pid\": 1, \"tid\": %d, \"args\": {\"name\": "
+               "\"writer\"}},\n", k);
+      for (i = 0; i < prof[k].event_count; i++) {
+         e = &prof[k].events[i];
+         fprintf(fp, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+               "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": "
+               "{\"gen\": %ld", names[e->phase], k, (e->t0 - prof_t0)*1e6,
+               (e->t1 - e->t0)*1e6, e->gen);
+         if (e->tile >= 0) fprintf(fp, ", \"tile\": %d", e->tile);
+         fprintf(fp, "}},\n");
+      }
+   }
+   fprintf(fp, "{\"name\": \"end\", \"ph\": \"i\", \"s\": \"g\", "
+         "\"pid\": 1, \"tid\": 0, \"ts\": %.3f}\n]}\n",
+         (Now() - prof_t0)*1e6);
+   fclose(fp);
+}  /* Prof_trace */
+#endif
+
+/*---------------------------------------------------------------------
+ * Library:    The functions declared in life.h.  They only use the
+ *             engines, kernels and pools, never the globals of a run.
+ *--------------------------------------------------------------------*/
+
+Life* Life_create(int m, int n, const char engine_name[],
+      const char rule_str[], int threads) {
+   const Engine* e = Find_engine(engine_name);
+   Life* life;
+   uint32_t r;
+   int k;
+
+   if (m < 3 || n < 3 || e == NULL || e->update == NULL
+         || !Parse_rule(rule_str, &r))
+      return NULL;
+   if (threads < 1) threads = 1;
+   if (threads > m) threads = m;
+
+   life = calloc(1, sizeof(Life));
+   if (life == NULL) return NULL;
+   life->engine = e;
+   life->update = Select_kernel(e, "auto");
+   life->rule = r;
+   life->m = m;
+   life->n = n;
+   life->units = e->units(n);
+   life->size = e->world_size(m, n);
+   life->threads = threads;
+   for (k = 0; k < 2; k++) {
+      life->w[k] = mmap(NULL, life->size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (life->w[k] == MAP_FAILED) {
+         life->w[k] = NULL;
+         goto fail;
+      }
+   }
+   life->part_live = aligned_alloc(CACHE_LINE,
+         threads*sizeof(Padded_long));
+   if (life->part_live == NULL) goto fail;
+   if (life->update == Lut_update) {
+      if (Lut_hold(r) == NULL) goto fail;
+      life->lut = 1;
+   }
+   if (threads > 1 && (life->pool = Pool_create(threads)) == NULL)
+      goto fail;
+   return life;
+
+fail:
+   Life_destroy(life);
+   return NULL;
+}  /* Life_create */
+
+long Life_load(Life* life, const char cells[]) {
+   int i, j;
+
+   life->live = 0;
+   for (i = 0; i < life->m; i++) {
+      life->engine->store_row(life->w[0], life->m, life->n, i,
+            cells + (size_t) i*life->n);
+      for (j = 0; j < life->n; j++)
+         if (cells[(size_t) i*life->n + j] == LIVE) life->live++;
+   }
+   if (life->engine->refresh != NULL)
+      life->engine->refresh(life->w[0], life->m, life->n, 0, life->m,
+            0, life->units);
+   life->gen = 0;
+   return life->live;
+}  /* Life_load */
+
+long Life_random(Life* life, uint64_t key, double prob) {
+   uint64_t threshold = Threshold(prob);
+   char* cells = malloc((size_t) life->m*life->n);
+   int i;
+
+   if (cells == NULL) return -1;
+   for (i = 0; i < life->m; i++)
+      Gen_cells(key, threshold, i, 0, life->n,
+            cells + (size_t) i*life->n);
+   Life_load(life, cells);
+   free(cells);
+   return life->live;
+}  /* Life_random */
+
+/*---------------------------------------------------------------------
+ * Function:   Life_rows
+ * Purpose:    Compute rows row0 .. row1-1 of the next generation of
+ *             a Life, and refresh the ghost cells that copy them
+ * Ret val:    Their population
+ */
+long Life_rows(Life* life, int row0, int row1) {
+   long live = life->update(life->w[0], life->w[1], life->m, life->n,
+         row0, row1, 0, life->units, life->rule);
+
+   if (life->engine->refresh != NULL)
+      life->engine->refresh(life->w[1], life->m, life->n, row0, row1,
+            0, life->units);
+   return live;
+}  /* Life_rows */
+
+/*---------------------------------------------------------------------
+ * Function:   Life_task
+ * Purpose:    Pool task:  thread rank computes its band of rows
+ */
+void Life_task(void* arg, long rank) {
+   Life* life = arg;
+   int row0, row1;
+
+   Block_range(life->m, life->threads, rank, &row0, &row1);
+   life->part_live[rank].value = Life_rows(life, row0, row1);
+}  /* Life_task */
+
+/*---------------------------------------------------------------------
+ * Function:   Life_step
+ * Purpose:    See life.h
+ *
+ * Note:       Each generation is one Pool_run_task, which returns when
+ *             all the bands are done, so it is the barrier.  A dead
+ *             world stays dead (there are no B0 rules), so its
+ *             generations are only counted.
+ */
+long Life_step(Life* life, long k) {
+   void* tmp;
+   int t;
+
+   if (k < 0) return -1;
+   for (; k > 0 && life->live > 0; k--) {
+      if (life->pool != NULL) {
+         Pool_run_task(life->pool, Life_task, life);
+         life->live = 0;
+         for (t = 0; t < life->threads; t++)
+            life->live += life->part_live[t].value;
+      } else {
+         life->live = Life_rows(life, 0, life->m);
+      }
+      tmp = life->w[0];
+      life->w[0] = life->w[1];
+      life->w[1] = tmp;
+      life->gen++;
+   }
+   life->gen += k;
+   return life->live;
+}  /* Life_step */
+
+long Life_population(const Life* life) {
+   return life->live;
+}  /* Life_population */
+
+long Life_generation(const Life* life) {
+   return life->gen;
+}  /* Life_generation */
+
+void Life_snapshot(const Life* life, char cells[]) {
+   int i;
+
+   for (i = 0; i < life->m; i++)
+      life->engine->load_row(life->w[0], life->m, life->n, i,
+            cells + (size_t) i*life->n);
+}  /* Life_snapshot */
+
+const void* Life_buffer(const Life* life, size_t* size_p) {
+   if (size_p != NULL) *size_p = life->size;
+   return life->w[0];
+}  /* Life_buffer */
+
+void Life_destroy(Life* life) {
+   int k;
+
+   if (life->pool != NULL) Pool_destroy(life->pool);
+   for (k = 0; k < 2; k++)
+      if (life->w[k] != NULL) munmap(life->w[k], life->size);
+   free(life->part_live);
+   if (life->lut) Lut_release(life->rule);
+   free(life);
+}  /* Life_destroy */
+  
+
+/*---------------------------------------------------------------------
+ * Function:   Print_world
+ * Purpose:    Print a world
+ * In args:    title
+ *             w1:  the world
+ *
+ * Note:       Whole rows are formatted into a large buffer, which is
+ *             written with a single fwrite whenever it fills up.
+ */
+void Print_world(char title[], const void* w1) {
+   int i, j;
+   char* row = malloc(n);
+   size_t size = OUTPUT_BUF > n + 1 ? OUTPUT_BUF : n + 1;
+   char* buf = malloc(size);
+   size_t used = 0;
+
+   printf("%s\n\n", title);
+
+   for (i = 0; i < m; i++) {
+      if (used + n + 1 > size) {
+         fwrite(buf, 1, used, stdout);
+         used = 0;
+      }
+      engine->load_row(w1, m, n, i, row);
+      for (j = 0; j < n; j++)
+         buf[used++] = row[j] == LIVE ? LIVE_IO : DEAD_IO;
+      buf[used++] = '\n';
+   }
+   fwrite(buf, 1, used, stdout);
+
+   printf("-------------\n");
+   free(buf);
+   free(row);
+}  /* Print_world */
+
+/*---------------------------------------------------------------------
+ * Function:   Want_output
+ * Purpose:    Decide whether generation gen should be handed to the
+ *             writer, to be printed or checkpointed
+ * In args:    gen
+ *             last:  whether gen is the last generation of the run
+ */
+int Want_output(long gen, int last) {
+   return Want_print(gen, last) || Want_checkpoint(gen);
+}  /* Want_output */
+
+/*---------------------------------------------------------------------
+ * Function:   Want_print
+ * Purpose:    Decide whether generation gen should be printed
+ * In args:    gen
+ *             last:  whether gen is the last generation of the run
+ * Global var: output_mode, output_every
+ */
+int Want_print(long gen, int last) {
+   switch (output_mode) {
+      case OUTPUT_ALL:   return 1;
+      case OUTPUT_EVERY: return gen % output_every == 0;
+      case OUTPUT_FINAL: return last;
+      default:           return 0;
+   }
+}  /* Want_print */
+
+/*---------------------------------------------------------------------
+ * Function:   Want_checkpoint
+ * Purpose:    Decide whether generation gen should be checkpointed:
+ *             every checkpoint_every generations, but not the one
+ *             the run started from
+ * In arg:     gen
+ * Global var: checkpoint_every, first_gen
+ */
+int Want_checkpoint(long gen) {
+   return checkpoint_every > 0 && gen % checkpoint_every == 0
+      && gen != first_gen;
+}  /* Want_checkpoint */
+
+/*---------------------------------------------------------------------
+ * Function:   Gens_to_output
+ * Purpose:    Find how many generations can be computed in one go
+ *             from curr_gen:  up to the next generation that's
+ *             printed, but no more than most, or than max_gens
+ * In arg:     most
+ * Ret val:    The number of generations
+ * Global var: curr_gen, max_gens
+ */
+int Gens_to_output(int most) {
+   long d = max_gens - curr_gen < most ? max_gens - curr_gen : most;
+   long g;
+
+   for (g = curr_gen + 1; g < curr_gen + d; g++)
+      if (Want_output(g, g == max_gens)) return g - curr_gen;
+   return d;
+}  /* Gens_to_output */
+
+/*---------------------------------------------------------------------
+ * Function:   Output_start
+ * Purpose:    Allocate the snapshot buffers and start the writer
+ *             thread
+ * Global var: snapshots, writer
+ */
+void Output_start(void) {
+   int i;
+
+   for (i = 0; i < SNAPSHOTS; i++)
+      snapshots[i].world = calloc(1, engine->world_size(m, n));
+   snap_head = snap_count = output_done = 0;
+   pthread_mutex_init(&output_mutex, NULL);
+   pthread_cond_init(&snap_ready, NULL);
+   pthread_cond_init(&snap_free, NULL);
+   Frames_start();
+   pthread_create(&writer, NULL, Writer, NULL);
+}  /* Output_start */
+
+/*---------------------------------------------------------------------
+ * Function:   Output_world
+ * Purpose:    Hand a copy of the world to the writer thread
+ * In args:    w1:  the world
+ *             gen, live:  its generation and population
+ * Global var: snapshots, snap_head, snap_count
+ *
+ * Note:       There are SNAPSHOTS buffers, so the caller only waits
+ *             when the writer is SNAPSHOTS generations behind.  The
+ *             slot being filled isn't counted yet, so the writer
+ *             doesn't touch it, and the copy is made without holding
+ *             output_mutex.
+ */
+void Output_world(const void* w1, long gen, long live) {
+   Snapshot* snap;
+
+   pthread_mutex_lock(&output_mutex);
+   while (snap_count == SNAPSHOTS)
+      pthread_cond_wait(&snap_free, &output_mutex);
+   snap = &snapshots[(snap_head + snap_count) % SNAPSHOTS];
+   pthread_mutex_unlock(&output_mutex);
+
+   if (engine->copy != NULL)
+      engine->copy(snap->world, w1, m, n);
+   else
+      memcpy(snap->world, w1, engine->world_size(m, n));
+   snap->gen = gen;
+   snap->live = live;
+   snap->print = Want_print(gen, gen == max_gens || cycle_period > 0
+         || BREAK);
+   snap->checkpoint = Want_checkpoint(gen);
+
+   pthread_mutex_lock(&output_mutex);
+   snap_count++;
+   pthread_cond_signal(&snap_ready);
+   pthread_mutex_unlock(&output_mutex);
+}  /* Output_world */
+
+/*---------------------------------------------------------------------
+ * Function:   Writer
+ * Purpose:    Thread function that prints and checkpoints the
+ *             snapshots in order until Output_finish is called and
+ *             it's done with all of them
+ * Global var: snapshots, snap_head, snap_count, output_done
+ */
+void* Writer(void* arg) {
+   Snapshot* snap;
+
+   PROF_THREAD(thread_count);
+   while (1) {
+      pthread_mutex_lock(&output_mutex);
+      while (snap_count == 0 && !output_done)
+         pthread_cond_wait(&snap_ready, &output_mutex);
+      if (snap_count == 0) {
+         pthread_mutex_unlock(&output_mutex);
+         break;
+      }
+      snap = &snapshots[snap_head];
+      pthread_mutex_unlock(&output_mutex);
+
+      PROF_START(t0);
+      if (snap->print) Write_frame(snap->world, snap->gen, snap->live);
+      if (snap->checkpoint)
+         Write_checkpoint(snap->world, snap->gen, snap->live);
+      PROF_STOP(PROF_OUTPUT, t0, snap->gen, -1);
+
+      pthread_mutex_lock(&output_mutex);
+      snap_head = (snap_head + 1) % SNAPSHOTS;
+      snap_count--;
+      pthread_cond_signal(&snap_free);
+      pthread_mutex_unlock(&output_mutex);
+   }
+   fflush(stdout);
+
+   return NULL;
+}  /* Writer */
+
+/*---------------------------------------------------------------------
+ * Function:   Output_finish
+ * Purpose:    Wait for the writer to print the snapshots it has,
+ *             then free them
+ */
+void Output_finish(void) {
+   int i;
+
+   pthread_mutex_lock(&output_mutex);
+   output_done = 1;
+   pthread_cond_signal(&snap_ready);
+   pthread_mutex_unlock(&output_mutex);
+   pthread_join(writer, NULL);
+   Frames_finish();
+
+   for (i = 0; i < SNAPSHOTS; i++) {
+      if (engine->release != NULL) engine->release(snapshots[i].world);
+      free(snapshots[i].world);
+   }
+   pthread_mutex_destroy(&output_mutex);
+   pthread_cond_destroy(&snap_ready);
+   pthread_cond_destroy(&snap_free);
+}  /* Output_finish */
+
+/*---------------------------------------------------------------------
+ * Function:   View_start
+ * Purpose:    Open the --view-out destination, work out which pixel
+ *             each row and col of the window falls in, and start the
+ *             thread that sends the frames
+ * Global var: view_h, view_w, view_rows, view_cols, view_out,
+ *             view_fd, view_ring, view_count, view_ybin, view_xbin,
+ *             view_ycells, view_xcells, view_frame, view_size,
+ *             view_due, view_next
+ *
+ * Note:       unix:path and tcp:host:port connect to a monitor that's
+ *             listening there, and stream the frames to it, one
+ *             after the other.  shm:name makes a POSIX shared memory
+ *             ring of VIEW_SLOTS frames (see View_sender).
+ */
+void View_start(void) {
+   int fd, k;
+   size_t size;
+
+   view_size = sizeof(View_header) + (size_t) view_h*view_w;
+   if (strncmp(view_out, "shm:", 4) == 0) {
+      size = sizeof(View_ring) + VIEW_SLOTS*view_size;
+      fd = shm_open(view_out + 4, O_CREAT | O_RDWR, 0644);
+      if (fd < 0 || ftruncate(fd, size) != 0) {
+         fprintf(stderr, "Can't make the shared memory %s\n", view_out + 4);
+         exit(1);
+      }
+      view_ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+            fd, 0);
+      close(fd);
+      if (view_ring == MAP_FAILED) {
+         fprintf(stderr, "Can't map the shared memory %s\n", view_out + 4);
+         exit(1);
+      }
+      memcpy(view_ring->magic, "LIFERING", 8);
+      view_ring->slots = VIEW_SLOTS;
+      view_ring->frame_size = view_size;
+      atomic_store(&view_ring->seq, 0);
+   } else {
+      view_fd = View_connect(view_out);
+   }
+
+   view_count = calloc((size_t) view_h*view_w, sizeof(atomic_uint));
+   view_ybin = malloc(view_rows*sizeof(int));
+   view_xbin = malloc(view_cols*sizeof(int));
+   view_ycells = calloc(view_h, sizeof(int));
+   view_xcells = calloc(view_w, sizeof(int));
+   for (k = 0; k < view_rows; k++) {
+      view_ybin[k] = (long) k*view_h/view_rows;
+      view_ycells[view_ybin[k]]++;
+   }
+   for (k = 0; k < view_cols; k++) {
+      view_xbin[k] = (long) k*view_w/view_cols;
+      view_xcells[view_xbin[k]]++;
+   }
+   view_frame = malloc(view_size);
+   view_busy = view_done = 0;
+   view_due = 1;
+   view_next = Now();
+   pthread_mutex_init(&view_mutex, NULL);
+   pthread_cond_init(&view_ready, NULL);
+   pthread_create(&view_thread, NULL, View_sender, NULL);
+}  /* View_start */
+
+/*---------------------------------------------------------------------
+ * Function:   View_connect
+ * Purpose:    Connect to the monitor at unix:path or tcp:host:port
+ * In arg:     dest
+ * Ret val:    The socket
+ */
+int View_connect(const char dest[]) {
+   struct sockaddr_un addr;
+   struct addrinfo hints, *info, *ai;
+   char host[256];
+   const char* port;
+   int fd = -1;
+
+   if (strncmp(dest, "unix:", 5) == 0) {
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strncpy(addr.sun_path, dest + 5, sizeof(addr.sun_path) - 1);
+      fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd >= 0
+            && connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+         close(fd);
+         fd = -1;
+      }
+   } else if (strncmp(dest, "tcp:", 4) == 0
+         && (port = strrchr(dest + 4, ':')) != NULL
+         && port - (dest + 4) < sizeof(host)) {
+      memcpy(host, dest + 4, port - (dest + 4));
+      host[port - (dest + 4)] = '\0';
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      if (getaddrinfo(host, port + 1, &hints, &info) == 0) {
+         for (ai = info; ai != NULL && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+               close(fd);
+               fd = -1;
+            }
+         }
+         freeaddrinfo(info);
+      }
+   }
+   if (fd < 0) {
+      fprintf(stderr, "Can't connect to %s:  --view-out should be "
+            "unix:path, tcp:host:port or shm:name\n", dest);
+      exit(1);
+   }
+   return fd;
+}  /* View_connect */
+
+/*---------------------------------------------------------------------
+ * Function:   View_tile
+ * Purpose:    Add the live cells of tile t of w2 (the generation just
+ *             computed) to the pixels of the --view frame
+ * In arg:     t
+ * Scratch:    cells:  n chars
+ * Global var: tiles, w2, view_row, view_col, view_rows, view_cols,
+ *             view_ybin, view_xbin, view_count
+ *
+ * Note:       Each thread does its own tiles, while they're still in
+ *             cache, so the reduction is spread over the threads like
+ *             the update.  A pixel can straddle tiles, so a row's
+ *             count for a pixel is added atomically, once per row.
+ */
+void View_tile(int t, unsigned char cells[]) {
+   const Tile* tile = &tiles[t];
+   int per = Unit_cells();
+   int i0 = tile->row0 > view_row ? tile->row0 : view_row;
+   int i1 = tile->row1 < view_row + view_rows
+          ? tile->row1 : view_row + view_rows;
+   int c0 = tile->col0*per > view_col ? tile->col0*per : view_col;
+   int c1 = tile->col1*per < n ? tile->col1*per : n;
+   int i, j, x, xj;
+   atomic_uint* pixels;
+   unsigned count;
+
+   if (c1 > view_col + view_cols) c1 = view_col + view_cols;
+   for (i = i0; i < i1 && c0 < c1; i++) {
+      engine->load_cells(w2, m, n, i, c0, c1 - c0, cells);
+      pixels = view_count + (size_t) view_ybin[i - view_row]*view_w;
+      x = view_xbin[c0 - view_col];
+      count = 0;
+      for (j = c0; j < c1; j++) {
+         xj = view_xbin[j - view_col];
+         if (xj != x) {
+            if (count > 0)
+               atomic_fetch_add_explicit(&pixels[x], count,
+                     memory_order_relaxed);
+            x = xj;
+            count = 0;
+         }
+         count += cells[j - c0];
+      }
+      if (count > 0)
+         atomic_fetch_add_explicit(&pixels[x], count, memory_order_relaxed);
+   }
+}  /* View_tile */
+
+/*---------------------------------------------------------------------
+ * Function:   View_frame
+ * Purpose:    At the barrier, turn the pixel counts into a frame for
+ *             the sending thread, and clear them
+ * Global var: view_count, view_frame, view_busy, view_next, view_fps,
+ *             curr_gen, live_count
+ *
+ * Note:       If the last frame is still being sent, this one is
+ *             dropped, and the next generation is reduced instead, so
+ *             a slow monitor never holds up the threads.
+ */
+void View_frame(void) {
+   View_header* hdr = (View_header*) view_frame;
+   unsigned char* pixels = view_frame + sizeof(View_header);
+   int y, x;
+   size_t k;
+
+   pthread_mutex_lock(&view_mutex);
+   if (!view_busy) {
+      memcpy(hdr->magic, "LIFEVIEW", 8);
+      hdr->gen = curr_gen;
+      hdr->live = live_count;
+      hdr->height = view_h;
+      hdr->width = view_w;
+      hdr->row = view_row;
+      hdr->col = view_col;
+      hdr->rows = view_rows;
+      hdr->cols = view_cols;
+      for (y = 0; y < view_h; y++)
+         for (x = 0; x < view_w; x++) {
+            k = (size_t) y*view_w + x;
+            pixels[k] = (255UL*atomic_load_explicit(&view_count[k],
+                     memory_order_relaxed) + view_ycells[y]*view_xcells[x]/2)
+                  /((unsigned long) view_ycells[y]*view_xcells[x]);
+         }
+      view_busy = 1;
+      view_next = Now() + 1/view_fps;
+      pthread_cond_signal(&view_ready);
+   }
+   pthread_mutex_unlock(&view_mutex);
+
+   for (k = 0; k < (size_t) view_h*view_w; k++)
+      atomic_store_explicit(&view_count[k], 0, memory_order_relaxed);
+}  /* View_frame */
+
+/*---------------------------------------------------------------------
+ * Function:   View_sender
+ * Purpose:    Thread function that sends each frame View_frame makes,
+ *             until View_finish is called
+ * Global var: view_frame, view_size, view_busy, view_done, view_fd,
+ *             view_ring
+ *
+ * Note:       In the shm ring, frame k goes in slot k % slots, and
+ *             then seq is set to k+1 (a release store).  A reader
+ *             loads seq (acquire), copies slot (seq-1) % slots, and
+ *             keeps the copy if seq hasn't moved on by slots - 1 or
+ *             more in the meantime.  If the monitor hangs up, the
+ *             frames are no longer sent.
+ */
+void* View_sender(void* arg) {
+   uint64_t seq;
+   size_t sent;
+   ssize_t got;
+
+   while (1) {
+      pthread_mutex_lock(&view_mutex);
+      while (!view_busy && !view_done)
+         pthread_cond_wait(&view_ready, &view_mutex);
+      if (!view_busy) {
+         pthread_mutex_unlock(&view_mutex);
+         break;
+      }
+      pthread_mutex_unlock(&view_mutex);
+
+      if (view_ring != NULL) {
+         seq = atomic_load_explicit(&view_ring->seq, memory_order_relaxed);
+         memcpy((char*) (view_ring + 1) + (seq % VIEW_SLOTS)*view_size,
+               view_frame, view_size);
+         atomic_store_explicit(&view_ring->seq, seq + 1,
+               memory_order_release);
+      } else if (view_fd >= 0) {
+         for (sent = 0; sent < view_size; sent += got) {
+            got = send(view_fd, view_frame + sent, view_size - sent,
+                  MSG_NOSIGNAL);
+            if (got <= 0) {
+               fprintf(stderr, "The --view monitor hung up\n");
+               close(view_fd);
+               view_fd = -1;
+               break;
+            }
+         }
+      }
+
+      pthread_mutex_lock(&view_mutex);
+      view_busy = 0;
+      pthread_mutex_unlock(&view_mutex);
+   }
+
+   return NULL;
+}  /* View_sender */
+
+/*---------------------------------------------------------------------
+ * Function:   View_finish
+ * Purpose:    Send the last frame, stop the sending thread, and
+ *             close the destination
+ */
+void View_finish(void) {
+   pthread_mutex_lock(&view_mutex);
+   view_done = 1;
+   pthread_cond_signal(&view_ready);
+   pthread_mutex_unlock(&view_mutex);
+   pthread_join(view_thread, NULL);
+
+   if (view_fd >= 0) close(view_fd);
+   if (view_ring != NULL)
+      munmap(view_ring, sizeof(View_ring) + VIEW_SLOTS*view_size);
+   view_fd = -1;
+   view_ring = NULL;
+   free(view_count);
+   free(view_ybin);
+   free(view_xbin);
+   free(view_ycells);
+   free(view_xcells);
+   free(view_frame);
+   pthread_mutex_destroy(&view_mutex);
+   pthread_cond_destroy(&view_ready);
+}  /* View_finish */
+
+/*---------------------------------------------------------------------
+ * Function:   Make_title
+ * Purpose:    Build the title Print_world prints above generation gen
+ * In args:    gen, live:  the generation and its population
+ * Out arg:    title
+ * Global var: show_population
+ */
+void Make_title(char title[], long gen, long live) {
+   if (show_population)
+      sprintf(title, "Generation %ld: population %ld", gen, live);
+   else
+      sprintf(title, "Generation %ld:", gen);
+}  /* Make_title */
+
+/*---------------------------------------------------------------------
+ * Function:   Frames_start
+ * Purpose:    Get ready to write frames:  open the index, and find
+ *             where in stdout the first frame will start
+ * Global var: index_file, index_fp, prev_bits, frames, out_pos,
+ *             frame_buf
+ *
+ * Note:       If stdout can't seek (it's a pipe, say), the offsets
+ *             in the index count from the start of the first frame.
+ */
+void Frames_start(void) {
+   frames = 0;
+   out_pos = ftello(stdout);
+   if (out_pos < 0) out_pos = 0;
+   frame_buf = malloc(OUTPUT_BUF);
+   frame_used = 0;
+   prev_bits = out_format == FORMAT_DELTA
+      ? calloc((size_t) m*((n + 63)/64), sizeof(uint64_t)) : NULL;
+   index_fp = NULL;
+   if (index_file != NULL) {
+      index_fp = fopen(index_file, "w");
+      if (index_fp == NULL) {
+         fprintf(stderr, "Can't write the index %s\n", index_file);
+         exit(1);
+      }
+      fprintf(index_fp, "# generation kind offset bytes\n");
+   }
+}  /* Frames_start */
+
+/*---------------------------------------------------------------------
+ * Function:   Frames_finish
+ * Purpose:    Close the index, and free the frame buffers
+ */
+void Frames_finish(void) {
+   if (index_fp != NULL) fclose(index_fp);
+   free(prev_bits);
+   free(frame_buf);
+}  /* Frames_finish */
+
+/*---------------------------------------------------------------------
+ * Function:   Write_frame
+ * Purpose:    Print one generation in the format chosen by --format,
+ *             and add it to the index
+ * In args:    w:  the world
+ *             gen, live:  its generation and population
+ * Global var: out_format, keyframe_every, frames, out_pos, index_fp
+ *
+ * Note:       The kinds of frame in the index are T (text), K (an
+ *             RLE frame, from which a reader can start) and D (a
+ *             delta from the frame before).
+ */
+void Write_frame(const void* w, long gen, long live) {
+   char title[MAX_TITLE];
+   char kind;
+
+   frame_bytes = 0;
+   if (out_format == FORMAT_TEXT) {
+      Make_title(title, gen, live);
+      Print_world(title, w);
+      frame_bytes = strlen(title) + 2 + (size_t) m*(n + 1)
+         + strlen("-------------\n");
+      kind = 'T';
+   } else if (out_format == FORMAT_RLE || frames % keyframe_every == 0) {
+      Write_rle(w, gen, live);
+      kind = 'K';
+   } else {
+      Write_delta(w, gen, live);
+      kind = 'D';
+   }
+   Frame_flush();
+
+   if (index_fp != NULL)
+      fprintf(index_fp, "%ld %c %lld %zu\n", gen, kind, out_pos,
+            frame_bytes);
+   out_pos += frame_bytes;
+   frames++;
+}  /* Write_frame */
+
+/*---------------------------------------------------------------------
+ * Function:   Write_rle
+ * Purpose:    Print a world as an RLE pattern, which the --pattern
+ *             option (or any Life program) can read back
+ * In args:    w, gen, live
+ * Global var: prev_bits:  if it's there, it's set to the world
+ *
+ * Note:       Each frame is a complete RLE file:  a "#C" comment with
+ *             the generation and population, the header, and the
+ *             runs, ending with '!'.  Dead cells at the end of a row
+ *             are left out, and empty rows are folded into the '$'
+ *             count.
+ */
+void Write_rle(const void* w, long gen, long live) {
+   char* row = malloc(n);
+   char header[MAX_TITLE];
+   int words = (n + 63)/64;
+   long eols = 0;
+   int i, j, k;
+
+   sprintf(header, "#C generation %ld population %ld\n"
+         "x = %d, y = %d, rule = %s\n", gen, live, n, m, rule_name);
+   Frame_put(header, strlen(header));
+   rle_line = 0;
+   for (i = 0; i < m; i++) {
+      engine->load_row(w, m, n, i, row);
+      if (prev_bits != NULL) {
+         memset(prev_bits + (size_t) i*words, 0, words*sizeof(uint64_t));
+         for (j = 0; j < n; j++)
+            if (row[j] == LIVE)
+               prev_bits[(size_t) i*words + j/64] |= 1ULL << (j % 64);
+      }
+      for (j = 0; j < n; j = k) {
+         for (k = j + 1; k < n && row[k] == row[j]; k++)
+            ;
+         if (row[j] == DEAD && k == n) break;
+         if (eols > 0) Rle_run(eols, '$');
+         eols = 0;
+         Rle_run(k - j, row[j] == LIVE ? 'o' : 'b');
+      }
+      eols++;
+   }
+   Frame_put("!\n", 2);
+   free(row);
+}  /* Write_rle */
+
+/*---------------------------------------------------------------------
+ * Function:   Rle_run
+ * Purpose:    Add a run of count tags to an RLE frame, starting a
+ *             new line if this one would get too long
+ * In args:    count, tag
+ * Global var: rle_line
+ */
+void Rle_run(long count, char tag) {
+   char run[32];
+   int len = count > 1 ? sprintf(run, "%ld%c", count, tag)
+                       : sprintf(run, "%c", tag);
+
+   if (rle_line + len > RLE_LINE) {
+      Frame_put("\n", 1);
+      rle_line = 0;
+   }
+   Frame_put(run, len);
+   rle_line += len;
+}  /* Rle_run */
+
+/*---------------------------------------------------------------------
+ * Function:   Write_delta
+ * Purpose:    Print the cells of a world that differ from the last
+ *             world printed
+ * In args:    w, gen, live
+ * In/out:     prev_bits:  the last world printed, then this one
+ *
+ * Note:       The frame is a "#D generation population" line, then
+ *             a line "i: j1 j2 ..." for each row i whose cells j1,
+ *             j2, ... changed (were born or died), then "!".
+ */
+void Write_delta(const void* w, long gen, long live) {
+   char* row = malloc(n);
+   char text[32];
+   int words = (n + 63)/64;
+   uint64_t* prev;
+   int i, j, len, first;
+
+   len = sprintf(text, "#D %ld %ld\n", gen, live);
+   Frame_put(text, len);
+   for (i = 0; i < m; i++) {
+      engine->load_row(w, m, n, i, row);
+      prev = prev_bits + (size_t) i*words;
+      first = 1;
+      for (j = 0; j < n; j++)
+         if ((row[j] == LIVE) != (int) (prev[j/64] >> (j % 64) & 1)) {
+            prev[j/64] ^= 1ULL << (j % 64);
+            len = first ? sprintf(text, "%d: %d", i, j)
+                        : sprintf(text, " %d", j);
+            Frame_put(text, len);
+            first = 0;
+         }
+      if (!first) Frame_put("\n", 1);
+   }
+   Frame_put("!\n", 2);
+   free(row);
+}  /* Write_delta */
+
+/*---------------------------------------------------------------------
+ * Function:   Frame_put
+ * Purpose:    Add text to the frame being written, writing the frame
+ *             buffer to stdout when it fills up
+ * In args:    text, len
+ * Global var: frame_buf, frame_used, frame_bytes
+ */
+void Frame_put(const char text[], size_t len) {
+   if (frame_used + len > OUTPUT_BUF) Frame_flush();
+   memcpy(frame_buf + frame_used, text, len);
+   frame_used += len;
+   frame_bytes += len;
+}  /* Frame_put */
+
+/*---------------------------------------------------------------------
+ * Function:   Frame_flush
+ * Purpose:    Write what's in the frame buffer to stdout
+ */
+void Frame_flush(void) {
+   fwrite(frame_buf, 1, frame_used, stdout);
+   frame_used = 0;
+}  /* Frame_flush */
+
+/*---------------------------------------------------------------------
+ * Function:   Write_checkpoint
+ * Purpose:    Write a world to checkpoint_file, in the format of
+ *             Ckpt_header
+ * In args:    w:  the world (a snapshot, or on process 0 of an MPI
+ *                run, the block of process 0)
+ *             gen, live:  its generation and population
+ * Global var: checkpoint_file, packbits
+ *
+ * Note:       The checkpoint is written to checkpoint_file.tmp, and
+ *             renamed when it's safely on disk, so a run that's
+ *             killed while it's writing leaves the last checkpoint
+ *             as it was.  If it can't be written, the run goes on.
+ */
+void Write_checkpoint(const void* w, long gen, long live) {
+   int words = (n + 63)/64, bands = (m + CKPT_BAND - 1)/CKPT_BAND;
+   size_t band_size = (size_t) CKPT_BAND*words*sizeof(uint64_t);
+   uint64_t* bits = malloc(band_size);
+   uint64_t* offsets = malloc((bands + 1)*sizeof(uint64_t));
+   unsigned char* coded = packbits ? malloc(band_size + band_size/128 + 1)
+                                   : NULL;
+   char* row = malloc(n);
+   char* tmp = malloc(strlen(checkpoint_file) + 5);
+   Ckpt_header h;
+   size_t len;
+   int b, i, i1, j, ok;
+   FILE* f;
+
+   sprintf(tmp, "%s.tmp", checkpoint_file);
+   f = fopen(tmp, "wb");
+   if (f == NULL) {
+      fprintf(stderr, "Can't write checkpoint %s\n", tmp);
+      goto out;
+   }
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, CKPT_MAGIC, sizeof(CKPT_MAGIC));
+   h.version = CKPT_VERSION;
+   h.flags = packbits ? CKPT_PACKBITS : 0;
+   h.m = m;
+   h.n = n;
+   h.gen = gen;
+   h.live = live;
+   snprintf(h.rule, sizeof(h.rule), "%s", rule_name);
+   h.band_rows = CKPT_BAND;
+   h.bands = bands;
+   fwrite(&h, sizeof(h), 1, f);
+   fwrite(offsets, sizeof(uint64_t), bands + 1, f);
+
+   offsets[0] = sizeof(h) + (bands + 1)*sizeof(uint64_t);
+   for (b = 0; b < bands; b++) {
+      i1 = (b + 1)*CKPT_BAND < m ? (b + 1)*CKPT_BAND : m;
+      memset(bits, 0, band_size);
+      for (i = b*CKPT_BAND; i < i1; i++) {
+         engine->load_row(w, m, n, i, row);
+         for (j = 0; j < n; j++)
+            if (row[j] == LIVE)
+               bits[(i - b*CKPT_BAND)*words + j/64] |= 1ULL << (j % 64);
+      }
+      len = (size_t) (i1 - b*CKPT_BAND)*words*sizeof(uint64_t);
+      if (packbits) {
+         len = Packbits_encode((unsigned char*) bits, len, coded);
+         fwrite(coded, 1, len, f);
+      } else {
+         fwrite(bits, 1, len, f);
+      }
+      offsets[b+1] = offsets[b] + len;
+   }
+   fseek(f, sizeof(h), SEEK_SET);
+   fwrite(offsets, sizeof(uint64_t), bands + 1, f);
+
+   ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+   ok = fclose(f) == 0 && ok;
+   if (!ok || rename(tmp, checkpoint_file) != 0)
+      fprintf(stderr, "Can't write checkpoint %s\n", checkpoint_file);
+
+out:
+   free(tmp);
+   free(row);
+   free(coded);
+   free(offsets);
+   free(bits);
+}  /* Write_checkpoint */
+
+/*---------------------------------------------------------------------
+ * Function:   Restore_world
+ * Purpose:    Start the run from the checkpoint in restore_file
+ * Out arg:    w1
+ * Global var: restore_file, curr_gen, first_gen, live_count
+ *
+ * Note:       The file is mapped, and bands that aren't compressed
+ *             are unpacked straight from the mapping.  The world
+ *             on the command line must be the size of the one in
+ *             the checkpoint.
+ */
+void Restore_world(void* w1) {
+   size_t size, band_size, len;
+   const char* text = Map_file(restore_file, &size);
+   const Ckpt_header* h = (const Ckpt_header*) text;
+   const uint64_t *offsets, *bits;
+   uint64_t* buf;
+   char* row;
+   int words = (n + 63)/64, b, i, i0, i1, j;
+
+   if (size < sizeof(*h) || memcmp(h->magic, CKPT_MAGIC,
+            sizeof(CKPT_MAGIC)) != 0 || h->version != CKPT_VERSION
+         || h->band_rows == 0 || (size - sizeof(*h))/sizeof(uint64_t)
+            < (size_t) h->bands + 1) {
+      fprintf(stderr, "%s isn't a checkpoint\n", restore_file);
+      exit(1);
+   }
+   if (h->m != m || h->n != n) {
+      fprintf(stderr, "%s is a %ld x %ld world\n", restore_file,
+            (long) h->m, (long) h->n);
+      exit(1);
+   }
+   if (memchr(h->rule, '\0', sizeof(h->rule)) == NULL) {
+      fprintf(stderr, "%s isn't a checkpoint\n", restore_file);
+      exit(1);
+   }
+   if (strcmp(h->rule, rule_name) != 0) {
+      fprintf(stderr, "%s was made with the rule %s\n",
+            restore_file, h->rule);
+      exit(1);
+   }
+   offsets = (const uint64_t*) (h + 1);
+   band_size = (size_t) h->band_rows*words*sizeof(uint64_t);
+   buf = malloc(band_size);
+   row = malloc(n);
+
+   for (b = 0; b < h->bands; b++) {
+      i0 = b*h->band_rows;
+      i1 = i0 + h->band_rows < m ? i0 + h->band_rows : m;
+      len = (size_t) (i1 - i0)*words*sizeof(uint64_t);
+      if (offsets[b] > offsets[b+1] || offsets[b+1] > size
+            || (!(h->flags & CKPT_PACKBITS)
+               && offsets[b+1] - offsets[b] != len)) {
+         fprintf(stderr, "%s is damaged\n", restore_file);
+         exit(1);
+      }
+      if (h->flags & CKPT_PACKBITS) {
+         if (Packbits_decode((const unsigned char*) text + offsets[b],
+                  offsets[b+1] - offsets[b], (unsigned char*) buf,
+                  band_size) != len) {
+            fprintf(stderr, "%s is damaged\n", restore_file);
+            exit(1);
+         }
+         bits = buf;
+      } else {
+         bits = (const uint64_t*) (text + offsets[b]);
+      }
+      for (i = i0; i < i1; i++) {
+         for (j = 0; j < n; j++)
+            if (bits[(i - i0)*words + j/64] >> (j % 64) & 1) {
+               row[j] = LIVE;
+               live_count++;
+            } else {
+               row[j] = DEAD;
+            }
+         engine->store_row(w1, m, n, i, row);
+      }
+   }
+   curr_gen = first_gen = h->gen;
+
+   free(row);
+   free(buf);
+   munmap((void*) text, size);
+}  /* Restore_world */
+
+/*---------------------------------------------------------------------
+ * Function:   Packbits_encode
+ * Purpose:    Compress a buffer with PackBits
+ * In args:    src, len
+ * Out arg:    dst:  room for len + len/128 + 1 bytes
+ * Ret val:    The number of bytes in dst
+ *
+ * Note:       A control byte c < 128 is followed by c+1 bytes to
+ *             copy; c > 128 is followed by one byte to repeat 257-c
+ *             times.  Runs of 3 or more are repeated, and mostly
+ *             empty worlds shrink by about 64x.
+ */
+size_t Packbits_encode(const unsigned char src[], size_t len,
+      unsigned char dst[]) {
+   size_t i = 0, out = 0, run, lit;
+
+   while (i < len) {
+      for (run = 1; i + run < len && run < 128 && src[i+run] == src[i];
+            run++)
+         ;
+      if (run >= 3) {
+         dst[out++] = 257 - run;
+         dst[out++] = src[i];
+         i += run;
+         continue;
+      }
+      for (lit = 0; i + lit < len && lit < 128; lit++)
+         if (i + lit + 2 < len && src[i+lit] == src[i+lit+1]
+               && src[i+lit] == src[i+lit+2])
+            break;
+      dst[out++] = lit - 1;
+      memcpy(dst + out, src + i, lit);
+      out += lit;
+      i += lit;
+   }
+   return out;
+}  /* Packbits_encode */
+
+/*---------------------------------------------------------------------
+ * Function:   Packbits_decode
+ * Purpose:    Undo Packbits_encode
+ * In args:    src, len
+ *             size:  room in dst
+ * Out arg:    dst
+ * Ret val:    The number of bytes decoded, or size + 1 if they
+ *             don't fit
+ */
+size_t Packbits_decode(const unsigned char src[], size_t len,
+      unsigned char dst[], size_t size) {
+   size_t i = 0, out = 0, count;
+
+   while (i < len) {
+      if (src[i] < 128) {
+         count = src[i] + 1;
+         if (i + 1 + count > len || out + count > size) return size + 1;
+         memcpy(dst + out, src + i + 1, count);
+         i += 1 + count;
+      } else if (src[i] > 128) {
+         count = 257 - src[i];
+         if (i + 1 >= len || out + count > size) return size + 1;
+         memset(dst + out, src[i+1], count);
+         i += 2;
+      } else {
+         count = 0;
+         i++;
+      }
+      out += count;
+   }
+   return out;
+}  /* Packbits_decode */
+
+/*---------------------------------------------------------------------
+ * Function:   Count_nbhrs
+ * Purpose:    Count the number of living nbhrs of the cell (i,j)
+ * In args:    w1:  current world
+ *             m:   number of rows in world
+ *             n:   number of cols in world
+ *             i:   row number of current cell
+ *             j:   col number of current cell
+ * Ret val:    The number of neighboring cells with living neighbors
+ *
+ * Note:       Since the top row of cells is adjacent to the bottom
+ *             row, and since the left col of cells is adjacent to the
+ *             right col, in a very small world, it's possible to
+ *             count a cell as a neighbor twice.  So we assume that
+ *             m and n are at least 3.
+ */
+int Count_nbhrs(int* w1, int m, int n, int i, int j) {
+   int i1, j1, i2, j2;
+   int count = 0;
+
+   for (i1 = i-1; i1 <= i+1; i1++)
+      for (j1 = j-1; j1 <= j+1; j1++) {
+         i2 = (i1 + m) % m;
+         j2 = (j1 + n) % n;
+         count += w1[i2*n + j2];
+      }
+   count -= w1[i*n + j];
+
+   return count;
+}  /* Count_nbhrs */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_units
+ * Purpose:    Number of column units in a row of the dense world
+ * In arg:     n:  number of cols in world
+ * Ret val:    n, since the dense engine works cell by cell
+ */
+int Dense_units(int n) {
+   return n;
+}  /* Dense_units */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_world_size
+ * Purpose:    Number of bytes in one dense world
+ */
+size_t Dense_world_size(int m, int n) {
+   return (size_t) m*n*sizeof(int);
+}  /* Dense_world_size */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_store_row
+ * Purpose:    Copy row i of LIVE/DEAD chars into the dense world w
+ */
+void Dense_store_row(void* w, int m, int n, int i, const char row[]) {
+   int* w1 = w;
+   int j;
+
+   for (j = 0; j < n; j++)
+      w1[i*n + j] = row[j];
+}  /* Dense_store_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_load_row
+ * Purpose:    Copy row i of the dense world w into a row of LIVE/DEAD
+ *             chars
+ */
+void Dense_load_row(const void* w, int m, int n, int i, char row[]) {
+   const int* w1 = w;
+   int j;
+
+   for (j = 0; j < n; j++)
+      row[j] = w1[i*n + j];
+}  /* Dense_load_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_update
+ * Purpose:    Compute the block row0 <= i < row1, col0 <= j < col1
+ *             of the next generation, one cell at a time
+ * In args:    w1:  current world
+ *             m, n:  size of the world
+ *             row0, row1, col0, col1:  the block
+ * Out arg:    w2:  next world
+ * Ret val:    Number of live cells in the block of w2
+ */
+long Dense_update(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   int* cur = (int*) w1;
+   int* next = w2;
+   int i, j, count;
+   long live = 0;
+
+   for (i = row0; i < row1; i++) {
+      for (j = col0; j < col1; j++) {
+         count = Count_nbhrs(cur, m, n, i, j);
+#        ifdef DEBUG
+         printf("curr_gen = %ld, i = %d, j = %d, count = %d\n",
+            curr_gen, i, j, count);
+#        endif
+         next[i*n + j] = RULE_NEXT(r, cur[i*n + j], count);
+         if (next[i*n + j] == LIVE) live++;
+      }
+   }
+
+   return live;
+}  /* Dense_update */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_update_window
+ * Purpose:    Dense_update, but keep the sum of each column of three
+ *             cells, and slide a window of three sums along the row,
+ *             instead of counting all eight neighbors of every cell
+ * In args:    w1:  current world
+ *             m, n:  size of the world
+ *             row0, row1, col0, col1:  the block
+ * Out arg:    w2:  next world
+ * Ret val:    Number of live cells in the block of w2
+ *
+ * Note:       sum[k] is the sum of column c0-1+k (wrapped) of rows
+ *             i-1, i and i+1.  Moving the window one cell adds a sum
+ *             and drops one, and moving down a row adds a cell to
+ *             each sum and drops one, so only the two wrapped columns
+ *             at the ends of the strip need a %.  The block is done
+ *             in strips of at most WINDOW_CELLS columns, so the sums
+ *             fit on the stack (and in L1).
+ */
+long Dense_update_window(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   const int* cur = w1;
+   int* next = w2;
+   int sum[WINDOW_CELLS + 2];
+   int c0, c1;
+   long live = 0;
+
+   for (c0 = col0; c0 < col1; c0 = c1) {
+      c1 = col1 - c0 > WINDOW_CELLS ? c0 + WINDOW_CELLS : col1;
+      live += Dense_window_strip(cur, next, m, n, row0, row1, c0, c1, r,
+            sum);
+   }
+   return live;
+}  /* Dense_update_window */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_window_strip
+ * Purpose:    Dense_update_window for a strip of at most WINDOW_CELLS
+ *             columns
+ * Out arg:    sum:  room for WINDOW_CELLS + 2 column sums
+ */
+long Dense_window_strip(const int* cur, int* next, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r, int sum[]) {
+   int width = col1 - col0;
+   int left = (col0 - 1 + n) % n;
+   int right = col1 % n;
+   const int *up, *mid, *dn;
+   int i, j, k, window;
+   long live = 0;
+
+   up = cur + (size_t) ((row0 - 1 + m) % m)*n;
+   mid = cur + (size_t) row0*n;
+   dn = cur + (size_t) ((row0 + 1) % m)*n;
+   sum[0] = up[left] + mid[left] + dn[left];
+   for (j = col0; j < col1; j++)
+      sum[j - col0 + 1] = up[j] + mid[j] + dn[j];
+   sum[width + 1] = up[right] + mid[right] + dn[right];
+
+   for (i = row0; i < row1; i++) {
+      mid = cur + (size_t) i*n;
+      window = sum[0] + sum[1];
+      for (k = 1; k <= width; k++) {
+         j = col0 + k - 1;
+         window += sum[k + 1];
+         next[(size_t) i*n + j] = RULE_NEXT(r, mid[j], window - mid[j]);
+         live += next[(size_t) i*n + j];
+         window -= sum[k - 1];
+      }
+      if (i + 1 == row1) break;
+
+      /* Move the sums down to rows i, i+1 and i+2 */
+      up = cur + (size_t) ((i - 1 + m) % m)*n;
+      dn = cur + (size_t) ((i + 2) % m)*n;
+      sum[0] += dn[left] - up[left];
+      for (j = col0; j < col1; j++)
+         sum[j - col0 + 1] += dn[j] - up[j];
+      sum[width + 1] += dn[right] - up[right];
+   }
+
+   return live;
+}  /* Dense_window_strip */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_offset
+ * Purpose:    Byte offset of cell (i,col) in the dense world
+ */
+size_t Dense_offset(int m, int n, int i, int col) {
+   return ((size_t) i*n + col)*sizeof(int);
+}  /* Dense_offset */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_load_cells
+ * Purpose:    Copy cells j..j+len-1 of row i of the dense world w
+ *             into cells
+ */
+void Dense_load_cells(const void* w, int m, int n, int i, int j, int len,
+      unsigned char cells[]) {
+   const int* src = (const int*) w + (size_t) i*n + j;
+   int k;
+
+   for (k = 0; k < len; k++)
+      cells[k] = src[k];
+}  /* Dense_load_cells */
+
+/*---------------------------------------------------------------------
+ * Function:   Dense_store_cells
+ * Purpose:    Copy cells into cells j..j+len-1 of row i of the dense
+ *             world w
+ */
+void Dense_store_cells(void* w, int m, int n, int i, int j, int len,
+      const unsigned char cells[]) {
+   int* dst = (int*) w + (size_t) i*n + j;
+   int k;
+
+   for (k = 0; k < len; k++)
+      dst[k] = cells[k];
+}  /* Dense_store_cells */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_units
+ * Purpose:    Number of 64-bit words in a row of the packed world
+ * In arg:     n:  number of cols in world
+ * Ret val:    ceil(n/64).  Cell (i,j) is bit j%64 of word j/64 of
+ *             row i.  The unused high bits of the last word of a
+ *             row are always 0.
+ */
+int Packed_units(int n) {
+   return (n + 63)/64;
+}  /* Packed_units */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_world_size
+ * Purpose:    Number of bytes in one packed world
+ */
+size_t Packed_world_size(int m, int n) {
+   return (size_t) m*Packed_units(n)*sizeof(uint64_t);
+}  /* Packed_world_size */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_store_row
+ * Purpose:    Pack row i of LIVE/DEAD chars into the packed world w
+ */
+void Packed_store_row(void* w, int m, int n, int i, const char row[]) {
+   int words = Packed_units(n);
+   uint64_t* dst = (uint64_t*) w + (size_t) i*words;
+   int j;
+
+   memset(dst, 0, words*sizeof(uint64_t));
+   for (j = 0; j < n; j++)
+      if (row[j] == LIVE)
+         dst[j/64] |= (uint64_t) 1 << (j%64);
+}  /* Packed_store_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_load_row
+ * Purpose:    Unpack row i of the packed world w into a row of
+ *             LIVE/DEAD chars
+ */
+void Packed_load_row(const void* w, int m, int n, int i, char row[]) {
+   int words = Packed_units(n);
+   const uint64_t* src = (const uint64_t*) w + (size_t) i*words;
+   int j;
+
+   for (j = 0; j < n; j++)
+      row[j] = (src[j/64] >> (j%64)) & 1 ? LIVE : DEAD;
+}  /* Packed_load_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_shift
+ * Purpose:    Find the west and east neighbors of the 64 cells in
+ *             word k of a packed row
+ * In args:    row:  the packed row
+ *             k:  the word
+ *             last:  index of the last word in the row
+ *             tail:  number of cells in the last word (1..64)
+ * Out args:   west_p:  bit b is the cell to the west of bit b of
+ *                word k (with toroidal wraparound)
+ *             east_p:  bit b is the cell to the east of bit b
+ *
+ * Note:       The bits of *west_p above the tail of the last word
+ *             are garbage, so the caller should mask the result.
+ */
+static inline void Packed_shift(const uint64_t row[], int k, int last,
+      int tail, uint64_t* west_p, uint64_t* east_p) {
+   uint64_t c = row[k];
+   uint64_t west_in, east_in;
+
+   west_in = k > 0 ? row[k-1] >> 63 : (row[last] >> (tail-1)) & 1;
+   east_in = k < last ? row[k+1] & 1 : row[0] & 1;
+   *west_p = (c << 1) | west_in;
+   *east_p = (c >> 1) | (east_in << (k < last ? 63 : tail-1));
+}  /* Packed_shift */
+
+/*---------------------------------------------------------------------
+ * Macro:      PACKED_RULE
+ * Purpose:    Compute a word of the next generation from the eight
+ *             neighbor words of a word of cells
+ * In args:    nw, no, ne:  neighbors in the row above
+ *             we, c, ea:   west neighbor, current cells, east neighbor
+ *             sw, so, se:  neighbors in the row below
+ * Out arg:    out:  the next generation of the cells in c
+ *
+ * Note:       The neighbor counts are summed bit-sliced with full
+ *             adders, so all the counts in a word are computed at
+ *             once.  A count of 8 wraps to 0, which is harmless since
+ *             both are fatal.  The arguments may be uint64_t or any
+ *             GCC vector type (__m256i, __m512i, uint64x2_t), so the
+ *             SIMD kernels share this code.
+ */
+#define PACKED_RULE(out, nw, no, ne, we, c, ea, sw, so, se) do {     \
+   __typeof__((c) ^ (c)) s_up_, c_up_, s_dn_, c_dn_, s_mid_, c_mid_;  \
+   __typeof__((c) ^ (c)) ones_, carry_, t_, k1_, twos_, fours_;       \
+   /* Sum each row of neighbors:  s_* has weight 1, c_* weight 2 */   \
+   s_up_ = (nw) ^ (no) ^ (ne);                                        \
+   c_up_ = ((nw) & (no)) | ((ne) & ((nw) ^ (no)));                    \
+   s_dn_ = (sw) ^ (so) ^ (se);                                        \
+   c_dn_ = ((sw) & (so)) | ((se) & ((sw) ^ (so)));                    \
+   s_mid_ = (we) ^ (ea);                                              \
+   c_mid_ = (we) & (ea);                                              \
+   /* Add the three rows */                                           \
+   ones_ = s_up_ ^ s_dn_ ^ s_mid_;                                    \
+   carry_ = (s_up_ & s_dn_) | (s_mid_ & (s_up_ ^ s_dn_));             \
+   t_ = c_up_ ^ c_dn_ ^ c_mid_;                                       \
+   k1_ = (c_up_ & c_dn_) | (c_mid_ & (c_up_ ^ c_dn_));                \
+   twos_ = t_ ^ carry_;                                               \
+   fours_ = k1_ ^ (t_ & carry_);                                      \
+   /* count == 3, or count == 2 and alive */                          \
+   (out) = twos_ & ~fours_ & (ones_ | (c));                           \
+} while (0)
+
+/*---------------------------------------------------------------------
+ * Macro:      PACKED_ANY_RULE
+ * Purpose:    PACKED_RULE for any rule r
+ * Note:       The counts get a fourth bit slice, eights_, so that 8
+ *             and 0 differ.  m_[k] is the next state of each cell if
+ *             it has k neighbors (it depends on whether the cell is
+ *             alive), and the count's bits then pick one of the nine
+ *             with a tree of selects.  With a constant r the masks
+ *             are constants, and most of it folds away.
+ */
+#define SEL_(x, a, b) ((a) ^ ((x) & ((a) ^ (b))))
+#define PACKED_ANY_RULE(out, r, nw, no, ne, we, c, ea, sw, so, se) do { \
+   __typeof__((c) ^ (c)) s_up_, c_up_, s_dn_, c_dn_, s_mid_, c_mid_;  \
+   __typeof__((c) ^ (c)) ones_, carry_, t_, k1_, c4_, twos_, fours_;  \
+   __typeof__((c) ^ (c)) eights_, m_[9];                              \
+   int k_;                                                            \
+   s_up_ = (nw) ^ (no) ^ (ne);                                        \
+   c_up_ = ((nw) & (no)) | ((ne) & ((nw) ^ (no)));                    \
+   s_dn_ = (sw) ^ (so) ^ (se);                                        \
+   c_dn_ = ((sw) & (so)) | ((se) & ((sw) ^ (so)));                    \
+   s_mid_ = (we) ^ (ea);                                              \
+   c_mid_ = (we) & (ea);                                              \
+   ones_ = s_up_ ^ s_dn_ ^ s_mid_;                                    \
+   carry_ = (s_up_ & s_dn_) | (s_mid_ & (s_up_ ^ s_dn_));             \
+   t_ = c_up_ ^ c_dn_ ^ c_mid_;                                       \
+   k1_ = (c_up_ & c_dn_) | (c_mid_ & (c_up_ ^ c_dn_));                \
+   twos_ = t_ ^ carry_;                                               \
+   c4_ = t_ & carry_;                                                 \
+   fours_ = k1_ ^ c4_;                                                \
+   eights_ = k1_ & c4_;                                               \
+   for (k_ = 0; k_ <= 8; k_++)                                        \
+      m_[k_] = SEL_((c), (c) ^ (c) ^ RULE_MASK(r, 0, k_),             \
+            (c) ^ (c) ^ RULE_MASK(r, 1, k_));                         \
+   m_[0] = SEL_(ones_, m_[0], m_[1]);                                 \
+   m_[2] = SEL_(ones_, m_[2], m_[3]);                                 \
+   m_[4] = SEL_(ones_, m_[4], m_[5]);                                 \
+   m_[6] = SEL_(ones_, m_[6], m_[7]);                                 \
+   m_[0] = SEL_(twos_, m_[0], m_[2]);                                 \
+   m_[4] = SEL_(twos_, m_[4], m_[6]);                                 \
+   m_[0] = SEL_(fours_, m_[0], m_[4]);                                \
+   (out) = SEL_(eights_, m_[0], m_[8]);                               \
+} while (0)
+
+/* PACKED_RULE for Conway's rule, PACKED_ANY_RULE for the others */
+#define PACKED_STEP(out, r, nw, no, ne, we, c, ea, sw, so, se) do {   \
+   if ((r) == RULE_CONWAY)                                            \
+      PACKED_RULE(out, nw, no, ne, we, c, ea, sw, so, se);            \
+   else                                                               \
+      PACKED_ANY_RULE(out, r, nw, no, ne, we, c, ea, sw, so, se);     \
+} while (0)
+
+/*---------------------------------------------------------------------
+ * Macro:      RULE_DISPATCH
+ * Purpose:    Return body(args..., r), passing the rule r of the
+ *             kernel as a constant when it's one of the common ones
+ * Note:       The bodies are always inlined, so each case is a copy
+ *             of the kernel specialized to its rule, as a template
+ *             would be:  Conway's rule costs nothing extra, and any
+ *             other rule is still branch free.
+ */
+#define RULE_DISPATCH(body, ...)                                       \
+   switch (r) {                                                       \
+      case RULE_CONWAY:   return body(__VA_ARGS__, RULE_CONWAY);      \
+      case RULE_HIGHLIFE: return body(__VA_ARGS__, RULE_HIGHLIFE);    \
+      case RULE_DAYNIGHT: return body(__VA_ARGS__, RULE_DAYNIGHT);    \
+      default:            return body(__VA_ARGS__, r);                \
+   }
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_update, Packed_rows
+ * Purpose:    Compute the block row0 <= i < row1, col0 <= k < col1
+ *             of the next generation, 64 cells at a time
+ * In args:    w1:  current world
+ *             m, n:  size of the world
+ *             row0, row1:  the rows of the block
+ *             col0, col1:  the words of the block
+ * Out arg:    w2:  next world
+ * Ret val:    Number of live cells in the block of w2
+ */
+static inline __attribute__((always_inline))
+long Packed_rows(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1,
+      uint32_t r) {
+   const uint64_t* cur = w1;
+   uint64_t* next = w2;
+   int words = Packed_units(n);
+   int last = words - 1;
+   int tail = n - 64*last;
+   uint64_t tail_mask = tail == 64 ? ~(uint64_t) 0
+                                   : ((uint64_t) 1 << tail) - 1;
+   const uint64_t *up, *mid, *dn;
+   uint64_t nw, ne, we, ea, sw, se, word;
+   int i, k;
+   long live = 0;
+
+   for (i = row0; i < row1; i++) {
+      up = cur + (size_t) ((i - 1 + m) % m)*words;
+      mid = cur + (size_t) i*words;
+      dn = cur + (size_t) ((i + 1) % m)*words;
+      for (k = col0; k < col1; k++) {
+         Packed_shift(up, k, last, tail, &nw, &ne);
+         Packed_shift(mid, k, last, tail, &we, &ea);
+         Packed_shift(dn, k, last, tail, &sw, &se);
+         PACKED_STEP(word, r, nw, up[k], ne, we, mid[k], ea,
+               sw, dn[k], se);
+         if (k == last) word &= tail_mask;
+         next[(size_t) i*words + k] = word;
+         live += __builtin_popcountll(word);
+      }
+   }
+
+   return live;
+}  /* Packed_rows */
+
+long Packed_update(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   RULE_DISPATCH(Packed_rows, w1, w2, m, n, row0, row1, col0, col1)
+}  /* Packed_update */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_offset
+ * Purpose:    Byte offset of word col of row i in the packed world
+ */
+size_t Packed_offset(int m, int n, int i, int col) {
+   return ((size_t) i*Packed_units(n) + col)*sizeof(uint64_t);
+}  /* Packed_offset */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_load_cells
+ * Purpose:    Copy cells j..j+len-1 of row i of the packed world w
+ *             into cells
+ */
+void Packed_load_cells(const void* w, int m, int n, int i, int j, int len,
+      unsigned char cells[]) {
+   const uint64_t* src = (const uint64_t*) w + (size_t) i*Packed_units(n);
+   int k;
+
+   for (k = 0; k < len; k++, j++)
+      cells[k] = (src[j/64] >> (j%64)) & 1;
+}  /* Packed_load_cells */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_store_cells
+ * Purpose:    Copy cells into cells j..j+len-1 of row i of the packed
+ *             world w
+ *
+ * Note:       Only the bits of the span are written, but the words
+ *             are read and written whole, so two threads may only
+ *             store spans of the same row at once if they are in
+ *             different words.
+ */
+void Packed_store_cells(void* w, int m, int n, int i, int j, int len,
+      const unsigned char cells[]) {
+   uint64_t* dst = (uint64_t*) w + (size_t) i*Packed_units(n);
+   uint64_t bit;
+   int k;
+
+   for (k = 0; k < len; k++, j++) {
+      bit = (uint64_t) 1 << (j%64);
+      dst[j/64] = cells[k] ? dst[j/64] | bit : dst[j/64] & ~bit;
+   }
+}  /* Packed_store_cells */
+
+/*---------------------------------------------------------------------
+ * Function:   Lut_hold
+ * Purpose:    Get the lut engine's table for rule r, making it if no
+ *             one holds it yet, and hold it until Lut_release
+ * In arg:     r
+ * Ret val:    The table:  entry index is the next generation of the
+ *             2x2 centre of the 4x4 square of cells index, or NULL if
+ *             there's no memory for it, or MAX_LUTS other rules are
+ *             held
+ * Global var: luts, lut_count, lut_mutex
+ *
+ * Note:       A slot is published by storing its rule after its
+ *             table is filled in, so Lut_table can find it without a
+ *             lock.  Bit 4*a + b of an index is cell (a,b) of the
+ *             square, and the centre is cells (1,1), (1,2), (2,1) and
+ *             (2,2).  Bits 0 and 1 of an entry are the next generation
+ *             of the top two cells of the centre, and bits 2 and 3
+ *             that of the bottom two.
+ */
+const unsigned char* Lut_hold(uint32_t r) {
+   int count, k, slot = -1, index, a, b, da, db, nbrs, alive;
+   unsigned char *table, out;
+
+   pthread_mutex_lock(&lut_mutex);
+   count = atomic_load_explicit(&lut_count, memory_order_relaxed);
+   for (k = 0; k < count; k++)
+      if (atomic_load_explicit(&luts[k].rule, memory_order_relaxed) == r) {
+         luts[k].refs++;
+         pthread_mutex_unlock(&lut_mutex);
+         return luts[k].table;
+      } else if (slot < 0 && atomic_load_explicit(&luts[k].rule,
+               memory_order_relaxed) == LUT_FREE) {
+         slot = k;
+      }
+   if (slot < 0 && count < MAX_LUTS) slot = count;
+   table = slot < 0 ? NULL : malloc(LUT_SIZE);
+   if (table == NULL) {
+      pthread_mutex_unlock(&lut_mutex);
+      return NULL;
+   }
+   for (index = 0; index < LUT_SIZE; index++) {
+      out = 0;
+      for (a = 1; a <= 2; a++)
+         for (b = 1; b <= 2; b++) {
+            nbrs = 0;
+            for (da = -1; da <= 1; da++)
+               for (db = -1; db <= 1; db++)
+                  nbrs += (index >> (4*(a+da) + b+db)) & 1;
+            alive = (index >> (4*a + b)) & 1;
+            nbrs -= alive;
+            out |= RULE_NEXT(r, alive, nbrs) << (2*(a-1) + b-1);
+         }
+      table[index] = out;
+   }
+   luts[slot].table = table;
+   luts[slot].refs = 1;
+   atomic_store_explicit(&luts[slot].rule, r, memory_order_release);
+   if (slot == count)
+      atomic_store_explicit(&lut_count, count + 1, memory_order_release);
+   pthread_mutex_unlock(&lut_mutex);
+   return table;
+}  /* Lut_hold */
+
+/*---------------------------------------------------------------------
+ * Function:   Lut_release
+ * Purpose:    Let go of the table Lut_hold(r) returned, and free it if
+ *             no one else holds it
+ * In arg:     r
+ * Global var: luts, lut_count, lut_mutex
+ */
+void Lut_release(uint32_t r) {
+   int count, k;
+
+   pthread_mutex_lock(&lut_mutex);
+   count = atomic_load_explicit(&lut_count, memory_order_relaxed);
+   for (k = 0; k < count; k++)
+      if (atomic_load_explicit(&luts[k].rule, memory_order_relaxed) == r) {
+         if (--luts[k].refs == 0) {
+            atomic_store_explicit(&luts[k].rule, LUT_FREE,
+                  memory_order_relaxed);
+            free(luts[k].table);
+            luts[k].table = NULL;
+         }
+         break;
+      }
+   pthread_mutex_unlock(&lut_mutex);
+}  /* Lut_release */
+
+/*---------------------------------------------------------------------
+ * Function:   Lut_table
+ * Purpose:    Find the table of rule r, which the caller holds (see
+ *             Lut_hold), without taking the lock
+ * In arg:     r
+ * Ret val:    The table
+ * Global var: luts, lut_count
+ *
+ * Note:       A held slot can't be freed or reused, so the table it
+ *             points to stays put while the caller looks it up.
+ */
+const unsigned char* Lut_table(uint32_t r) {
+   int count = atomic_load_explicit(&lut_count, memory_order_acquire);
+   int k;
+
+   for (k = 0; k < count; k++)
+      if (atomic_load_explicit(&luts[k].rule, memory_order_acquire) == r)
+         return luts[k].table;
+   return NULL;
+}  /* Lut_table */
+
+/*---------------------------------------------------------------------
+ * Function:   Lut_bits
+ * Purpose:    Find the cells a lookup of word k of a packed row needs:
+ *             the 64 cells of the word, and one more on each side
+ * In args:    row, k, last, tail:  as in Packed_shift
+ * Out args:   lo_p:  bit b is the cell to the west of bit b of the
+ *                word (with toroidal wraparound)
+ *             hi_p:  bit 0 is bit 63 of the word, and bit 1 the cell
+ *                to its east
+ *
+ * Note:       In the last word the cells after the tail are the first
+ *             two of the row, so a square that runs past the end of
+ *             the row wraps around.
+ */
+static inline void Lut_bits(const uint64_t row[], int k, int last,
+      int tail, uint64_t* lo_p, uint64_t* hi_p) {
+   uint64_t c = row[k];
+   uint64_t west_in = k > 0 ? row[k-1] >> 63 : (row[last] >> (tail-1)) & 1;
+   uint64_t lo = (c << 1) | west_in;
+   uint64_t hi = c >> 63;
+   int b;
+
+   if (k < last) {
+      hi |= (row[k+1] & 1) << 1;
+   } else {
+      /* Cells 0 and 1 of the row go to bits tail+1 and tail+2 */
+      for (b = tail + 1; b <= tail + 2 && b <= 65; b++)
+         if (b < 64)
+            lo |= ((row[0] >> (b - tail - 1)) & 1) << b;
+         else
+            hi |= ((row[0] >> (b - tail - 1)) & 1) << (b - 64);
+   }
+   *lo_p = lo;
+   *hi_p = hi;
+}  /* Lut_bits */
+
+/*---------------------------------------------------------------------
+ * Function:   Lut_update
+ * Purpose:    Compute the block row0 <= i < row1, col0 <= k < col1
+ *             of the next generation of a packed world, a 2x2 square
+ *             of cells at a time, by looking up its 4x4 neighborhood
+ *             in the table of the rule r
+ * In args:    w1:  current world
+ *             m, n:  size of the world
+ *             row0, row1:  the rows of the block
+ *             col0, col1:  the words of the block
+ *             r:  the rule
+ * Out arg:    w2:  next world
+ * Ret val:    Number of live cells in the block of w2
+ *
+ * Note:       The rows are taken in pairs from row0.  If the block
+ *             has an odd number of rows, only the top half of the
+ *             last pair is stored.  The shifts and lookups don't
+ *             need SIMD, so this is the fast engine for hosts without
+ *             it.
+ */
+long Lut_update(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   const uint64_t* cur = w1;
+   uint64_t* next = w2;
+   const unsigned char* lut = Lut_table(r);
+   int words = Packed_units(n);
+   int last = words - 1;
+   int tail = n - 64*last;
+   uint64_t tail_mask = tail == 64 ? ~(uint64_t) 0
+                                   : ((uint64_t) 1 << tail) - 1;
+   const uint64_t* rows[4];
+   uint64_t lo[4], hi[4], top, bottom, out;
+   int i, k, a, j;
+   unsigned index;
+   long live = 0;
+
+   for (i = row0; i < row1; i += 2) {
+      for (a = 0; a < 4; a++)
+         rows[a] = cur + (size_t) ((i - 1 + a + m) % m)*words;
+      for (k = col0; k < col1; k++) {
+         for (a = 0; a < 4; a++)
+            Lut_bits(rows[a], k, last, tail, &lo[a], &hi[a]);
+         top = bottom = 0;
+         for (j = 0; j < 62; j += 2) {
+            index = ((lo[0] >> j) & 0xF) | ((lo[1] >> j) & 0xF) << 4
+                  | ((lo[2] >> j) & 0xF) << 8 | ((lo[3] >> j) & 0xF) << 12;
+            out = lut[index];
+            top |= (out & 3) << j;
+            bottom |= (out >> 2) << j;
+         }
+         index = (lo[0] >> 62 | hi[0] << 2) | (lo[1] >> 62 | hi[1] << 2) << 4
+               | (lo[2] >> 62 | hi[2] << 2) << 8
+               | (lo[3] >> 62 | hi[3] << 2) << 12;
+         out = lut[index];
+         top |= (out & 3) << 62;
+         bottom |= (out >> 2) << 62;
+         if (k == last) {
+            top &= tail_mask;
+            bottom &= tail_mask;
+         }
+         next[(size_t) i*words + k] = top;
+         live += __builtin_popcountll(top);
+         if (i + 1 < row1) {
+            next[(size_t) (i+1)*words + k] = bottom;
+            live += __builtin_popcountll(bottom);
+         }
+      }
+   }
+
+   return live;
+}  /* Lut_update */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_world_size
+ * Purpose:    Number of bytes in one halo world:  m+2 rows of n+2
+ *             cells.  Cell (i,j) of the world is at (i+1)*(n+2) + j+1.
+ */
+size_t Halo_world_size(int m, int n) {
+   return (size_t) (m+2)*(n+2);
+}  /* Halo_world_size */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_store_row
+ * Purpose:    Copy row i of LIVE/DEAD chars into the halo world w.
+ *             The ghost border is not updated:  call Halo_refresh
+ *             after storing the last row.
+ */
+void Halo_store_row(void* w, int m, int n, int i, const char row[]) {
+   unsigned char* dst = (unsigned char*) w + (size_t) (i+1)*(n+2) + 1;
+
+   memcpy(dst, row, n);
+}  /* Halo_store_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_load_row
+ * Purpose:    Copy row i of the halo world w into a row of LIVE/DEAD
+ *             chars
+ */
+void Halo_load_row(const void* w, int m, int n, int i, char row[]) {
+   const unsigned char* src =
+      (const unsigned char*) w + (size_t) (i+1)*(n+2) + 1;
+
+   memcpy(row, src, n);
+}  /* Halo_load_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_update, Halo_rows
+ * Purpose:    Compute the block row0 <= i < row1, col0 <= j < col1
+ *             of the next generation, reading the neighbors of each
+ *             cell directly from the padded world
+ * In args:    w1:  current world, with a fresh ghost border
+ *             m, n:  size of the world
+ *             row0, row1, col0, col1:  the block
+ * Out arg:    w2:  next world (the ghost border is not written)
+ * Ret val:    Number of live cells in the block of w2
+ */
+static inline __attribute__((always_inline))
+long Halo_rows(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1,
+      uint32_t r) {
+   const unsigned char *up, *mid, *dn;
+   unsigned char* next;
+   size_t stride = n + 2;
+   int i, j, count;
+   long live = 0;
+
+   for (i = row0; i < row1; i++) {
+      mid = (const unsigned char*) w1 + (i+1)*stride + 1;
+      up = mid - stride;
+      dn = mid + stride;
+      next = (unsigned char*) w2 + (i+1)*stride + 1;
+      for (j = col0; j < col1; j++) {
+         count = up[j-1] + up[j] + up[j+1]
+               + mid[j-1]        + mid[j+1]
+               + dn[j-1] + dn[j] + dn[j+1];
+         next[j] = r == RULE_CONWAY
+            ? (count == 3) | ((count == 2) & mid[j])
+            : RULE_NEXT(r, mid[j], count);
+         live += next[j];
+      }
+   }
+
+   return live;
+}  /* Halo_rows */
+
+long Halo_update(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   RULE_DISPATCH(Halo_rows, w1, w2, m, n, row0, row1, col0, col1)
+}  /* Halo_update */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_update_window, Halo_window_rows
+ * Purpose:    Halo_rows with the running column sums of
+ *             Dense_update_window.  The ghost border makes the
+ *             wrapped columns ordinary ones.
+ * In args:    w1:  current world, with a fresh ghost border
+ *             m, n:  size of the world
+ *             row0, row1, col0, col1:  the block
+ * Out arg:    w2:  next world (the ghost border is not written)
+ * Ret val:    Number of live cells in the block of w2
+ */
+static inline __attribute__((always_inline))
+long Halo_window_rows(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1,
+      uint32_t r) {
+   size_t stride = n + 2;
+   unsigned char sum[WINDOW_CELLS + 2];
+   const unsigned char *cells, *up, *mid, *dn;
+   unsigned char* next;
+   int c0, c1, width, i, k, window;
+   long live = 0;
+
+   /* The block is done in strips of at most WINDOW_CELLS columns, so
+      the sums fit on the stack.  sum[k] is column c0-1+k, and mid[k]
+      is cell (i,c0-1+k).  Each cell adds its three sums afresh instead
+      of sliding one window along the row:  the cells are then
+      independent, which is faster on bytes than the chain of a
+      running window */
+   for (c0 = col0; c0 < col1; c0 = c1) {
+      c1 = col1 - c0 > WINDOW_CELLS ? c0 + WINDOW_CELLS : col1;
+      cells = (const unsigned char*) w1 + c0;
+      width = c1 - c0;
+      for (k = 0; k < width + 2; k++)
+         sum[k] = cells[row0*stride + k] + cells[(row0+1)*stride + k]
+            + cells[(row0+2)*stride + k];
+
+      for (i = row0; i < row1; i++) {
+         mid = cells + (i+1)*stride;
+         next = (unsigned char*) w2 + (i+1)*stride + c0 + 1;
+         for (k = 1; k <= width; k++) {
+            window = sum[k - 1] + sum[k] + sum[k + 1];
+            next[k - 1] = r == RULE_CONWAY
+               ? (window == 3) | ((window == 4) & mid[k])
+               : RULE_NEXT(r, mid[k], window - mid[k]);
+            live += next[k - 1];
+         }
+         if (i + 1 == row1) break;
+
+         up = cells + i*stride;
+         dn = cells + (i+3)*stride;
+         for (k = 0; k < width + 2; k++)
+            sum[k] += dn[k] - up[k];
+      }
+   }
+
+   return live;
+}  /* Halo_window_rows */
+
+long Halo_update_window(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   RULE_DISPATCH(Halo_window_rows, w1, w2, m, n, row0, row1, col0, col1)
+}  /* Halo_update_window */
+
+/*---------------------------------------------------------------------
+ * Function:   Has_window
+ * Purpose:    The window kernels are portable C, so every host has them
+ */
+int Has_window(void) {
+   return 1;
+}  /* Has_window */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_refresh
+ * Purpose:    Copy the cells of the block row0 <= i < row1,
+ *             col0 <= j < col1 that lie on an edge of the world into
+ *             the opposite side of the ghost border, so that the halo
+ *             world is a torus
+ * In/out arg: w:  the halo world
+ * In args:    m, n:  size of the world
+ *             row0, row1, col0, col1:  the block, (0, m, 0, n) for
+ *                the whole world
+ *
+ * Note:       Each thread refreshes the blocks it just computed, so
+ *             the border is written in parallel, and a block's ghost
+ *             cells are ready as soon as the block is.  A block copies
+ *             only its own cells, and its four corner ghost cells are
+ *             written by the blocks that hold the corners of the
+ *             world, so no two threads write the same ghost cell or
+ *             read cells another thread is writing.
+ */
+void Halo_refresh(void* w, int m, int n, int row0, int row1,
+      int col0, int col1) {
+   unsigned char* cells = w;
+   size_t stride = n + 2;
+   size_t top = stride, bot = m*stride;   /* rows 0 and m-1 */
+   int i;
+
+   for (i = row0 + 1; i <= row1; i++) {
+      if (col1 == n) cells[i*stride] = cells[i*stride + n];
+      if (col0 == 0) cells[i*stride + n + 1] = cells[i*stride + 1];
+   }
+   if (row1 == m) {
+      memcpy(cells + col0 + 1, cells + bot + col0 + 1, col1 - col0);
+      if (col1 == n) cells[0] = cells[bot + n];
+      if (col0 == 0) cells[n + 1] = cells[bot + 1];
+   }
+   if (row0 == 0) {
+      memcpy(cells + bot + stride + col0 + 1, cells + top + col0 + 1,
+            col1 - col0);
+      if (col1 == n) cells[bot + stride] = cells[top + n];
+      if (col0 == 0) cells[bot + stride + n + 1] = cells[top + 1];
+   }
+}  /* Halo_refresh */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_offset
+ * Purpose:    Byte offset of cell (i,col) in the halo world
+ */
+size_t Halo_offset(int m, int n, int i, int col) {
+   return (size_t) (i+1)*(n+2) + col + 1;
+}  /* Halo_offset */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_load_cells
+ * Purpose:    Copy cells j..j+len-1 of row i of the halo world w
+ *             into cells
+ */
+void Halo_load_cells(const void* w, int m, int n, int i, int j, int len,
+      unsigned char cells[]) {
+   memcpy(cells, (const unsigned char*) w + Halo_offset(m, n, i, j), len);
+}  /* Halo_load_cells */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_store_cells
+ * Purpose:    Copy cells into cells j..j+len-1 of row i of the halo
+ *             world w.  The ghost border is not updated.
+ */
+void Halo_store_cells(void* w, int m, int n, int i, int j, int len,
+      const unsigned char cells[]) {
+   memcpy((unsigned char*) w + Halo_offset(m, n, i, j), cells, len);
+}  /* Halo_store_cells */
+
+/*---------------------------------------------------------------------
+ * HashLife engine (Gosper, 1984)
+ *
+ * The world is a quadtree of Hl_nodes.  A node at level k is a
+ * 2^k x 2^k square of cells made of four level k-1 quadrants, and
+ * the level 0 nodes are single cells.  Nodes are canonical:  Hl_find
+ * looks a node up by its quadrants in a hash table before making a
+ * new one, so equal squares are the same node however often they
+ * appear, in space or in time.  The result of a node (its centre
+ * after 2^j generations) is memoized in the node, so a pattern that
+ * repeats is only ever computed once.
+ *
+ * On the infinite plane (--topology=plane) the root is padded with
+ * empty space until it is big enough for the pattern to stay inside
+ * it, and its result is the plane 2^j generations later.  The torus
+ * is handled by tiling the plane with copies of the world.
+ * This needs m and n to be powers of two:  the world is copied until
+ * it fills a square of side max(m,n), and a node made of four copies
+ * of that square is a piece of the tiled plane.  Its result is the
+ * world 2^j generations later, shifted by half its width.
+ *
+ * Nodes are garbage collected by mark and sweep between steps, when
+ * the table holds more than hl_max_nodes of them.
+ *-------------------------------------------------------------------*/
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_alloc
+ * Purpose:    Get a node from the free list, or a new block of nodes
+ */
+static Hl_node* Hl_alloc(void) {
+   Hl_block* block;
+   Hl_node* p;
+   int i;
+
+   if (hl_free == NULL) {
+      block = malloc(sizeof(Hl_block));
+      block->next = hl_blocks;
+      hl_blocks = block;
+      for (i = 0; i < HL_BLOCK; i++) {
+         block->nodes[i].next = hl_free;
+         hl_free = &block->nodes[i];
+      }
+   }
+   p = hl_free;
+   hl_free = p->next;
+   return p;
+}  /* Hl_alloc */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_hash
+ * Purpose:    Hash the four quadrants of a node
+ */
+static inline size_t Hl_hash(const Hl_node* nw, const Hl_node* ne,
+      const Hl_node* sw, const Hl_node* se) {
+   uint64_t h = (uintptr_t) nw;
+
+   h = h*0x9E3779B97F4A7C15ULL + (uintptr_t) ne;
+   h = h*0x9E3779B97F4A7C15ULL + (uintptr_t) sw;
+   h = h*0x9E3779B97F4A7C15ULL + (uintptr_t) se;
+   return h ^ (h >> 29);
+}  /* Hl_hash */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_grow
+ * Purpose:    Double the number of buckets in the hash table
+ */
+static void Hl_grow(void) {
+   size_t new_buckets = 2*hl_buckets;
+   Hl_node** table = calloc(new_buckets, sizeof(Hl_node*));
+   Hl_node *p, *next;
+   size_t b, h;
+
+   for (b = 0; b < hl_buckets; b++)
+      for (p = hl_table[b]; p != NULL; p = next) {
+         next = p->next;
+         h = Hl_hash(p->nw, p->ne, p->sw, p->se) & (new_buckets - 1);
+         p->next = table[h];
+         table[h] = p;
+      }
+   free(hl_table);
+   hl_table = table;
+   hl_buckets = new_buckets;
+}  /* Hl_grow */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_find
+ * Purpose:    Find the canonical node with the given quadrants,
+ *             making it if it doesn't exist yet
+ */
+Hl_node* Hl_find(Hl_node* nw, Hl_node* ne, Hl_node* sw, Hl_node* se) {
+   size_t h = Hl_hash(nw, ne, sw, se) & (hl_buckets - 1);
+   Hl_node* p;
+
+   for (p = hl_table[h]; p != NULL; p = p->next)
+      if (p->nw == nw && p->ne == ne && p->sw == sw && p->se == se)
+         return p;
+
+   p = Hl_alloc();
+   p->nw = nw;
+   p->ne = ne;
+   p->sw = sw;
+   p->se = se;
+   p->level = nw->level + 1;
+   p->pop = nw->pop + ne->pop + sw->pop + se->pop;
+   p->result = NULL;
+   p->result_step = -1;
+   p->mark = 0;
+   p->next = hl_table[h];
+   hl_table[h] = p;
+   if (++hl_count > hl_buckets) Hl_grow();
+   return p;
+}  /* Hl_find */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_base
+ * Purpose:    Result of a level 2 node:  its centre 2x2 cells after
+ *             one generation, found by counting neighbors
+ */
+static Hl_node* Hl_base(const Hl_node* p) {
+   int cell[4][4], next[2][2];
+   const Hl_node* q[2][2] = {{p->nw, p->ne}, {p->sw, p->se}};
+   int i, j, di, dj, count;
+
+   for (i = 0; i < 4; i++)
+      for (j = 0; j < 4; j++) {
+         const Hl_node* quad = q[i/2][j/2];
+         const Hl_node* leaf = i%2 == 0 ? (j%2 == 0 ? quad->nw : quad->ne)
+                                        : (j%2 == 0 ? quad->sw : quad->se);
+         cell[i][j] = leaf->pop;
+      }
+   for (i = 1; i <= 2; i++)
+      for (j = 1; j <= 2; j++) {
+         count = -cell[i][j];
+         for (di = -1; di <= 1; di++)
+            for (dj = -1; dj <= 1; dj++)
+               count += cell[i+di][j+dj];
+         next[i-1][j-1] = RULE_NEXT(rule, cell[i][j], count);
+      }
+   return Hl_find(&hl_cells[next[0][0]], &hl_cells[next[0][1]],
+         &hl_cells[next[1][0]], &hl_cells[next[1][1]]);
+}  /* Hl_base */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_centre
+ * Purpose:    The level k-1 node in the centre of a level k node
+ */
+static inline Hl_node* Hl_centre(const Hl_node* p) {
+   return Hl_find(p->nw->se, p->ne->sw, p->sw->ne, p->se->nw);
+}  /* Hl_centre */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_result
+ * Purpose:    The centre of a node after 2^j generations
+ * In args:    p:  a node at level k >= 2
+ *             j:  0 <= j <= k-2
+ * Ret val:    The level k-1 node in the centre of p, 2^j generations
+ *             later.  It only depends on p, so it's memoized in p.
+ *
+ * Note:       The nine overlapping level k-1 squares of p are reduced
+ *             to level k-2 squares (advanced 2^(k-3) generations if
+ *             j is k-2, or just their centres otherwise), which are
+ *             put together into four overlapping level k-1 squares,
+ *             and their results are the four quadrants of the answer.
+ */
+Hl_node* Hl_result(Hl_node* p, int j) {
+   Hl_node *n[3][3], *c[3][3], *res;
+   int x, y, full, sub;
+
+   if (p->result != NULL && p->result_step == j) return p->result;
+
+   if (p->level == 2) {
+      res = Hl_base(p);
+   } else {
+      n[0][0] = p->nw;
+      n[0][1] = Hl_find(p->nw->ne, p->ne->nw, p->nw->se, p->ne->sw);
+      n[0][2] = p->ne;
+      n[1][0] = Hl_find(p->nw->sw, p->nw->se, p->sw->nw, p->sw->ne);
+      n[1][1] = Hl_centre(p);
+      n[1][2] = Hl_find(p->ne->sw, p->ne->se, p->se->nw, p->se->ne);
+      n[2][0] = p->sw;
+      n[2][1] = Hl_find(p->sw->ne, p->se->nw, p->sw->se, p->se->sw);
+      n[2][2] = p->se;
+
+      /* Half the generations in each pass, or all of them in the
+       * second pass */
+      full = j == p->level - 2;
+      sub = full ? j-1 : j;
+      for (x = 0; x < 3; x++)
+         for (y = 0; y < 3; y++)
+            c[x][y] = full ? Hl_result(n[x][y], sub) : Hl_centre(n[x][y]);
+
+      res = Hl_find(
+            Hl_result(Hl_find(c[0][0], c[0][1], c[1][0], c[1][1]), sub),
+            Hl_result(Hl_find(c[0][1], c[0][2], c[1][1], c[1][2]), sub),
+            Hl_result(Hl_find(c[1][0], c[1][1], c[2][0], c[2][1]), sub),
+            Hl_result(Hl_find(c[1][1], c[1][2], c[2][1], c[2][2]), sub));
+   }
+
+   p->result = res;
+   p->result_step = j;
+   return res;
+}  /* Hl_result */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_build
+ * Purpose:    Build the node for a square of the world w:  tiled on
+ *             the torus, surrounded by dead cells on the plane
+ * In args:    w:  the world, in the packed layout
+ *             level:  the square is 2^level x 2^level
+ *             row, col:  its upper left corner
+ */
+Hl_node* Hl_build(const uint64_t w[], int level, long row, long col) {
+   long half;
+   int i, j, words;
+
+   if (level == 0) {
+      if (plane && (row >= m || col >= n)) return &hl_cells[0];
+      words = Packed_units(n);
+      i = row % m;
+      j = col % n;
+      return &hl_cells[(w[(size_t) i*words + j/64] >> (j%64)) & 1];
+   }
+   half = 1L << (level - 1);
+   return Hl_find(Hl_build(w, level-1, row, col),
+         Hl_build(w, level-1, row, col + half),
+         Hl_build(w, level-1, row + half, col),
+         Hl_build(w, level-1, row + half, col + half));
+}  /* Hl_build */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_fill
+ * Purpose:    Set the live cells of a node in the packed world w.
+ *             Cells outside the m x n world (which can only happen on
+ *             the plane) are ignored.
+ * In args:    p, row, col:  the node and its upper left corner
+ * Out arg:    w:  should be all dead to start with
+ */
+void Hl_fill(const Hl_node* p, long row, long col, uint64_t w[]) {
+   long half, side = 1L << p->level;
+
+   if (p->pop == 0 || row >= m || col >= n) return;
+   if (row + side <= 0 || col + side <= 0) return;
+   if (p->level == 0) {
+      w[(size_t) row*Packed_units(n) + col/64] |= (uint64_t) 1 << (col%64);
+      return;
+   }
+   half = 1L << (p->level - 1);
+   Hl_fill(p->nw, row, col, w);
+   Hl_fill(p->ne, row, col + half, w);
+   Hl_fill(p->sw, row + half, col, w);
+   Hl_fill(p->se, row + half, col + half, w);
+}  /* Hl_fill */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_step_pow2
+ * Purpose:    Advance the torus 2^j generations
+ * In args:    t:  level k node holding the torus (tiled if m != n)
+ *             j
+ * Ret val:    The torus 2^j generations later
+ */
+Hl_node* Hl_step_pow2(Hl_node* t, int j) {
+   int k = t->level;
+   Hl_node *p, *res;
+
+   if (j <= k-1) {
+      /* The result is the torus shifted by half its width, so swap
+       * its quadrants diagonally to put it back */
+      res = Hl_result(Hl_find(t, t, t, t), j);
+      return Hl_find(res->se, res->sw, res->ne, res->nw);
+   }
+
+   /* The result is shifted by 2^j, a multiple of the side of the
+    * torus, so any aligned level k square of it is the torus */
+   for (p = t; p->level < j + 2; p = Hl_find(p, p, p, p));
+   for (res = Hl_result(p, j); res->level > k; res = res->nw);
+   return res;
+}  /* Hl_step_pow2 */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_empty
+ * Purpose:    The empty node at a level
+ */
+Hl_node* Hl_empty(int level) {
+   Hl_node* e;
+
+   if (level == 0) return &hl_cells[0];
+   if (hl_empty[level] == NULL) {
+      e = Hl_empty(level - 1);
+      hl_empty[level] = Hl_find(e, e, e, e);
+   }
+   return hl_empty[level];
+}  /* Hl_empty */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_plane_step_pow2
+ * Purpose:    Advance the plane 2^j generations
+ * In args:    t:  a node holding every live cell on the plane
+ *             j
+ * In/out args:row_p, col_p:  position of the upper left corner of t
+ * Ret val:    A node holding the plane 2^j generations later
+ *
+ * Note:       t is padded with a border of empty space, doubling its
+ *             side each time, until its live cells are all in the
+ *             centre of its centre and it's at level j+3 or more.
+ *             The live cells spread at most 2^j <= side/8 cells, so
+ *             they all end up in the centre, which is the result.
+ */
+Hl_node* Hl_plane_step_pow2(Hl_node* t, int j, long* row_p, long* col_p) {
+   Hl_node* e;
+   long half;
+
+   while (t->level < j + 3 || Hl_centre(Hl_centre(t))->pop != t->pop) {
+      e = Hl_empty(t->level - 1);
+      half = 1L << (t->level - 1);
+      t = Hl_find(Hl_find(e, e, e, t->nw), Hl_find(e, e, t->ne, e),
+            Hl_find(e, t->sw, e, e), Hl_find(t->se, e, e, e));
+      *row_p -= half;
+      *col_p -= half;
+   }
+   *row_p += 1L << (t->level - 2);
+   *col_p += 1L << (t->level - 2);
+   return Hl_result(t, j);
+}  /* Hl_plane_step_pow2 */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_advance
+ * Purpose:    Advance the world gens generations, a power of two at
+ *             a time, collecting garbage between the powers
+ * In args:    t, gens
+ * In/out args:row_p, col_p:  position of the upper left corner of t
+ *                (always 0 on the torus)
+ * Ret val:    The world gens generations later
+ * Global var: hl_root is kept by the garbage collector too
+ */
+Hl_node* Hl_advance(Hl_node* t, long gens, long* row_p, long* col_p) {
+   int j;
+
+   for (j = 0; gens > 0; j++, gens >>= 1)
+      if (gens & 1) {
+         if (plane)
+            t = Hl_plane_step_pow2(t, j, row_p, col_p);
+         else
+            t = Hl_step_pow2(t, j);
+         if (hl_count > hl_max_nodes) Hl_gc(t);
+      }
+   return t;
+}  /* Hl_advance */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_mark
+ * Purpose:    Mark a node and everything under it as in use
+ */
+static void Hl_mark(Hl_node* p) {
+   if (p->level == 0 || p->mark) return;
+   p->mark = 1;
+   Hl_mark(p->nw);
+   Hl_mark(p->ne);
+   Hl_mark(p->sw);
+   Hl_mark(p->se);
+}  /* Hl_mark */
+
+/*---------------------------------------------------------------------
+ * Function:   Hl_gc
+ * Purpose:    Free every node that isn't part of root, hl_root or
+ *             one of the empty nodes.
+ *             The memoized results of the nodes that are kept are
+ *             kept too if they survive, and forgotten otherwise.
+ *             If most of the nodes are still in use, hl_max_nodes is
+ *             doubled so that collection doesn't happen every step.
+ */
+void Hl_gc(Hl_node* root) {
+   Hl_node **link, *p;
+   size_t b;
+   int level;
+
+   Hl_mark(root);
+   if (hl_root != NULL) Hl_mark(hl_root);
+   for (level = 1; level < HL_MAX_LEVEL; level++)
+      if (hl_empty[level] != NULL) Hl_mark(hl_empty[level]);
+
+   for (b = 0; b < hl_buckets; b++) {
+      link = &hl_table[b];
+      while ((p = *link) != NULL)
+         if (p->mark) {
+            link = &p->next;
+         } else {
+            *link = p->next;
+            p->next = hl_free;
+            hl_free = p;
+            hl_count--;
+         }
+   }
+   for (b = 0; b < hl_buckets; b++)
+      for (p = hl_table[b]; p != NULL; p = p->next) {
+         if (p->result != NULL && !p->result->mark
+               && p->result->level > 0) {
+            p->result = NULL;
+            p->result_step = -1;
+         }
+      }
+   for (b = 0; b < hl_buckets; b++)
+      for (p = hl_table[b]; p != NULL; p = p->next)
+         p->mark = 0;
+
+   if (hl_count > hl_max_nodes/2) hl_max_nodes *= 2;
+}  /* Hl_gc */
+
+/*---------------------------------------------------------------------
+ * Function:   Hashlife_run
+ * Purpose:    Run the whole simulation with HashLife, on the torus or
+ *             the plane.  Jumps straight
+ *             to the next generation that's printed (or
+ *             checkpointed), so with
+ *             --output=final (or none) max_gens can be astronomical.
+ * Global var: w1:  generation 0 in, in the packed layout, and the
+ *                world of each printed generation out
+ *             curr_gen, live_count
+ *
+ * Note:       If the world dies, the generation it dies in is found
+ *             by a binary search over the last jump, which costs
+ *             little since the results are memoized.
+ */
+void Hashlife_run(void) {
+   long side = m > n ? m : n;
+   long reps, step, lo, hi, mid;
+   long row = 0, col = 0, next_row, next_col;
+   int k, i;
+   Hl_node* next;
+
+   if (!plane && ((m & (m-1)) != 0 || (n & (n-1)) != 0 || m < 4 || n < 4)) {
+      fprintf(stderr, "The hashlife engine needs m and n to be powers "
+            "of two, at least 4, on the torus\n");
+      exit(1);
+   }
+   for (k = 2; (1L << k) < side; k++);
+   reps = plane ? 1 : (side/m)*(side/n);
+
+   hl_cells[0].level = hl_cells[1].level = 0;
+   hl_cells[0].pop = 0;
+   hl_cells[1].pop = 1;
+   hl_buckets = 1 << 16;
+   hl_table = calloc(hl_buckets, sizeof(Hl_node*));
+   hl_root = Hl_build(w1, k, 0, 0);
+
+   while (curr_gen < max_gens) {
+      if (output_mode == OUTPUT_ALL)
+         step = 1;
+      else if (output_mode == OUTPUT_EVERY)
+         step = output_every - curr_gen % output_every;
+      else
+         step = max_gens - curr_gen;
+      if (checkpoint_every > 0
+            && step > checkpoint_every - curr_gen % checkpoint_every)
+         step = checkpoint_every - curr_gen % checkpoint_every;
+      if (step > max_gens - curr_gen) step = max_gens - curr_gen;
+
+      next_row = row;
+      next_col = col;
+      next = Hl_advance(hl_root, step, &next_row, &next_col);
+      if (next->pop == 0) {
+         for (lo = 0, hi = step; hi - lo > 1; ) {
+            mid = lo + (hi - lo)/2;
+            next_row = row;
+            next_col = col;
+            if (Hl_advance(hl_root, mid, &next_row, &next_col)->pop == 0)
+               hi = mid;
+            else
+               lo = mid;
+         }
+         curr_gen += hi;
+         live_count = 0;
+         Bench_stamp();
+         break;
+      }
+      hl_root = next;
+      row = next_row;
+      col = next_col;
+      curr_gen += step;
+      live_count = hl_root->pop/reps;
+      Bench_stamp();
+
+      if (Want_output(curr_gen, curr_gen == max_gens)) {
+         memset(w1, 0, Packed_world_size(m, n));
+         Hl_fill(hl_root, row, col, w1);
+         Output_world(w1, curr_gen, live_count);
+      }
+      if (hl_count > hl_max_nodes) Hl_gc(hl_root);
+   }
+
+   while (hl_blocks != NULL) {
+      Hl_block* block = hl_blocks;
+      hl_blocks = block->next;
+      free(block);
+   }
+   free(hl_table);
+   for (i = 0; i < 2; i++) hl_cells[i].result = NULL;
+   memset(hl_empty, 0, sizeof(hl_empty));
+}  /* Hashlife_run */
+
+/*---------------------------------------------------------------------
+ * Sparse engine
+ *
+ * Only the live cells are stored, as 64-bit keys holding the row and
+ * column (each offset by SP_BIAS, so that keys sort by row and then
+ * column, negative coordinates included).  A generation is computed
+ * by adding each live cell to its eight neighbors' counts in an
+ * open-addressing hash table, so the cost is proportional to the
+ * population, not the area.  The world may be the usual torus, or
+ * the infinite plane, of which the m x n window at (0,0) is printed.
+ *-------------------------------------------------------------------*/
+
+static inline uint64_t Sp_key(long row, long col) {
+   return (uint64_t) (row + SP_BIAS) << 32 | (uint32_t) (col + SP_BIAS);
+}  /* Sp_key */
+
+static inline long Sp_row(uint64_t key) {
+   return (long) (key >> 32) - SP_BIAS;
+}  /* Sp_row */
+
+static inline long Sp_col(uint64_t key) {
+   return (long) (uint32_t) key - SP_BIAS;
+}  /* Sp_col */
+
+/*---------------------------------------------------------------------
+ * Function:   Sp_hash
+ * Purpose:    Mix the bits of a key (the splitmix64 finalizer)
+ */
+static inline uint64_t Sp_hash(uint64_t key) {
+   key ^= key >> 30;
+   key *= 0xBF58476D1CE4E5B9ULL;
+   key ^= key >> 27;
+   key *= 0x94D049BB133111EBULL;
+   return key ^ (key >> 31);
+}  /* Sp_hash */
+
+/*---------------------------------------------------------------------
+ * Function:   Sp_append
+ * Purpose:    Add a live cell to the end of a sparse world
+ */
+static void Sp_append(Sparse_world* w, uint64_t key) {
+   if (w->count == w->cap) {
+      w->cap = w->cap == 0 ? 1024 : 2*w->cap;
+      w->cells = realloc(w->cells, w->cap*sizeof(uint64_t));
+   }
+   w->cells[w->count++] = key;
+}  /* Sp_append */
+
+static int Sp_compare(const void* a, const void* b) {
+   uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+
+   return x < y ? -1 : x > y;
+}  /* Sp_compare */
+
+/*---------------------------------------------------------------------
+ * Function:   Sparse_world_size
+ * Purpose:    Size of the fixed part of a sparse world.  The cells
+ *             themselves are allocated as they're added.
+ */
+size_t Sparse_world_size(int m, int n) {
+   return sizeof(Sparse_world);
+}  /* Sparse_world_size */
+
+/*---------------------------------------------------------------------
+ * Function:   Sparse_store_row
+ * Purpose:    Add the live cells of row i to the sparse world w.  The
+ *             rows should be stored in order, so the cells stay
+ *             sorted.
+ */
+void Sparse_store_row(void* w, int m, int n, int i, const char row[]) {
+   Sparse_world* sw = w;
+   int j;
+
+   for (j = 0; j < n; j++)
+      if (row[j] == LIVE) Sp_append(sw, Sp_key(i, j));
+   sw->sorted = 1;
+}  /* Sparse_store_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Sparse_load_row
+ * Purpose:    Find row i of the window in a sorted sparse world
+ * Note:       A binary search finds the first cell of the row
+ */
+void Sparse_load_row(const void* w, int m, int n, int i, char row[]) {
+   const Sparse_world* sw = w;
+   uint64_t first = Sp_key(i, -SP_BIAS);
+   size_t lo = 0, hi = sw->count, mid;
+   long col;
+
+   memset(row, DEAD, n);
+   while (lo < hi) {
+      mid = lo + (hi - lo)/2;
+      if (sw->cells[mid] < first) lo = mid + 1; else hi = mid;
+   }
+   for (; lo < sw->count && Sp_row(sw->cells[lo]) == i; lo++) {
+      col = Sp_col(sw->cells[lo]);
+      if (col >= 0 && col < n) row[col] = LIVE;
+   }
+}  /* Sparse_load_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Sparse_copy
+ * Purpose:    Copy the sparse world src to dst for the writer, and
+ *             sort the copy so that Sparse_load_row can search it
+ */
+void Sparse_copy(void* dst, const void* src, int m, int n) {
+   Sparse_world* d = dst;
+   const Sparse_world* s = src;
+
+   if (d->cap < s->count) {
+      d->cap = s->count;
+      d->cells = realloc(d->cells, d->cap*sizeof(uint64_t));
+   }
+   memcpy(d->cells, s->cells, s->count*sizeof(uint64_t));
+   d->count = s->count;
+   if (!s->sorted) qsort(d->cells, d->count, sizeof(uint64_t), Sp_compare);
+   d->sorted = 1;
+}  /* Sparse_copy */
+
+/*---------------------------------------------------------------------
+ * Function:   Sparse_release
+ * Purpose:    Free the cells of a sparse world
+ */
+void Sparse_release(void* w) {
+   Sparse_world* sw = w;
+
+   free(sw->cells);
+   sw->cells = NULL;
+   sw->count = sw->cap = 0;
+}  /* Sparse_release */
+
+/*---------------------------------------------------------------------
+ * Function:   Sp_add
+ * Purpose:    Add to the value of a key in the neighbor table
+ * In args:    key, val
+ * Global var: sp_keys, sp_vals, sp_cap
+ */
+static inline void Sp_add(uint64_t key, unsigned char val) {
+   size_t h = Sp_hash(key) & (sp_cap - 1);
+
+   while (sp_keys[h] != key && sp_keys[h] != SP_EMPTY)
+      h = (h + 1) & (sp_cap - 1);
+   sp_keys[h] = key;
+   sp_vals[h] += val;
+}  /* Sp_add */
+
+/*---------------------------------------------------------------------
+ * Function:   Sparse_step
+ * Purpose:    Compute the next generation of a sparse world
+ * In/out arg: w
+ * Global var: plane, sp_keys, sp_vals, sp_cap
+ *
+ * Note:       Each live cell adds 1 to its neighbors' entries in the
+ *             table and SP_ALIVE to its own, so an entry holds the
+ *             count and whether the cell is alive.  The table has at
+ *             least twice as many slots as the up to 9*count keys it
+ *             can get, so probes stay short.
+ */
+void Sparse_step(Sparse_world* w) {
+   size_t need = 18*w->count + 16, c, h;
+   long row, col, r1, c1;
+   int di, dj, count;
+   uint64_t* old = w->cells;
+   size_t old_count = w->count;
+
+   if (sp_cap < need) {
+      for (sp_cap = 1024; sp_cap < need; sp_cap *= 2);
+      free(sp_keys);
+      free(sp_vals);
+      sp_keys = malloc(sp_cap*sizeof(uint64_t));
+      sp_vals = malloc(sp_cap);
+   }
+   memset(sp_keys, 0xff, sp_cap*sizeof(uint64_t));
+   memset(sp_vals, 0, sp_cap);
+
+   for (c = 0; c < old_count; c++) {
+      row = Sp_row(old[c]);
+      col = Sp_col(old[c]);
+      Sp_add(old[c], SP_ALIVE);
+      for (di = -1; di <= 1; di++)
+         for (dj = -1; dj <= 1; dj++) {
+            if (di == 0 && dj == 0) continue;
+            r1 = row + di;
+            c1 = col + dj;
+            if (!plane) {
+               r1 = (r1 + m) % m;
+               c1 = (c1 + n) % n;
+            }
+            Sp_add(Sp_key(r1, c1), 1);
+         }
+   }
+
+   w->cells = NULL;
+   w->count = w->cap = 0;
+   for (h = 0; h < sp_cap; h++)
+      if (sp_keys[h] != SP_EMPTY) {
+         count = sp_vals[h] & (SP_ALIVE - 1);
+         if (RULE_NEXT(rule, (sp_vals[h] & SP_ALIVE) != 0, count))
+            Sp_append(w, sp_keys[h]);
+      }
+   w->sorted = 0;
+   free(old);
+}  /* Sparse_step */
+
+/*---------------------------------------------------------------------
+ * Function:   Sparse_run
+ * Purpose:    Run the whole simulation with the sparse engine
+ * Global var: w1:  the sparse world, generation 0 in
+ *             curr_gen, live_count, BREAK
+ *
+ * Note:       The sparse engine runs in a single thread.
+ */
+void Sparse_run(void) {
+   Sparse_world* w = w1;
+
+   while (curr_gen < max_gens) {
+      Sparse_step(w);
+      curr_gen++;
+      live_count = w->count;
+      Bench_stamp();
+      if (live_count == 0) {
+         BREAK = 1;
+         break;
+      }
+      if (Want_output(curr_gen, curr_gen == max_gens))
+         Output_world(w, curr_gen, live_count);
+   }
+
+   free(sp_keys);
+   free(sp_vals);
+   sp_keys = NULL;
+   sp_vals = NULL;
+   sp_cap = 0;
+}  /* Sparse_run */
+
+#ifdef USE_GPU
+/*---------------------------------------------------------------------
+ * Function:   Gpu_engine_run
+ * Purpose:    Run the whole simulation on the GPU:  upload w1, step
+ *             the device world from one printed generation to the
+ *             next, and download it only to print it
+ * In arg:     packed:  1 for gpu-packed, 0 for gpu
+ * Global var: w1, curr_gen, live_count, BREAK
+ *
+ * Note:       A batch can run past the generation the world dies in;
+ *             that doesn't matter, since it's not printed.
+ */
+static void Gpu_engine_run(int packed) {
+   struct Gpu_world* g = Gpu_create(m, n, packed, GPU_BATCH, rule);
+   long live[GPU_BATCH];
+   int gens, k;
+
+   if (g == NULL) {
+      fprintf(stderr, "Can't allocate the GPU world\n");
+      exit(1);
+   }
+   Gpu_upload(g, w1);
+   while (curr_gen < max_gens) {
+      gens = Gens_to_output(GPU_BATCH);
+      Gpu_step(g, gens, live);
+      for (k = 0; k < gens && live[k] > 0; k++)
+         ;
+      if (k < gens) {
+         curr_gen += k + 1;
+         live_count = 0;
+         BREAK = 1;
+         Bench_stamp();
+         break;
+      }
+      curr_gen += gens;
+      live_count = live[gens-1];
+      Bench_stamp();
+      if (Want_output(curr_gen, curr_gen == max_gens)) {
+         Gpu_download(g, w1);
+         Output_world(w1, curr_gen, live_count);
+      }
+   }
+   Gpu_destroy(g);
+}  /* Gpu_engine_run */
+
+void Gpu_run(void) {
+   Gpu_engine_run(0);
+}  /* Gpu_run */
+
+void Gpu_packed_run(void) {
+   Gpu_engine_run(1);
+}  /* Gpu_packed_run */
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+/*---------------------------------------------------------------------
+ * Function:   Rule_bytes
+ * Purpose:    The next state of a dead (alive = 0) or live cell for
+ *             each neighbor count 0..15, as a table for pshufb
+ */
+static inline __m128i Rule_bytes(uint32_t r, int alive) {
+   unsigned char t[16];
+   int k;
+
+   for (k = 0; k < 16; k++)
+      t[k] = k <= 8 ? RULE_NEXT(r, alive, k) : 0;
+   return _mm_loadu_si128((const __m128i*) t);
+}  /* Rule_bytes */
+
+/*---------------------------------------------------------------------
+ * Function:   Has_avx2, Has_avx512
+ * Purpose:    Ask CPUID whether the host (and its OS) supports the
+ *             instructions used by the AVX2 and AVX-512 kernels
+ */
+int Has_avx2(void) {
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+}  /* Has_avx2 */
+
+int Has_avx512(void) {
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx512f")
+      && __builtin_cpu_supports("avx512bw")
+      && __builtin_cpu_supports("popcnt");
+}  /* Has_avx512 */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_update_avx2, Halo_rows_avx2
+ * Purpose:    Halo_update, 32 cells per instruction
+ * Note:       The neighbor sums are at most 8, so they fit in the
+ *             bytes of the vector.  Columns left over at the end of
+ *             a row go to the scalar kernel.
+ */
+__attribute__((target("avx2,popcnt"), always_inline))
+static inline long Halo_rows_avx2(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1,
+      uint32_t r) {
+   const unsigned char *up, *mid, *dn;
+   unsigned char* next;
+   size_t stride = n + 2;
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i one = _mm256_set1_epi8(1);
+   const __m256i two = _mm256_set1_epi8(2);
+   const __m256i three = _mm256_set1_epi8(3);
+   const __m256i born = _mm256_broadcastsi128_si256(Rule_bytes(r, 0));
+   const __m256i stays = _mm256_broadcastsi128_si256(Rule_bytes(r, 1));
+   __m256i sum, alive, out, total;
+   int i, j;
+   long live = 0;
+
+#  define LD(p) _mm256_loadu_si256((const __m256i*) (p))
+   for (i = row0; i < row1; i++) {
+      mid = (const unsigned char*) w1 + (i+1)*stride + 1;
+      up = mid - stride;
+      dn = mid + stride;
+      next = (unsigned char*) w2 + (i+1)*stride + 1;
+      total = zero;
+      for (j = col0; j + 32 <= col1; j += 32) {
+         sum = _mm256_add_epi8(LD(up + j-1), LD(up + j));
+         sum = _mm256_add_epi8(sum, LD(up + j+1));
+         sum = _mm256_add_epi8(sum, LD(mid + j-1));
+         sum = _mm256_add_epi8(sum, LD(mid + j+1));
+         sum = _mm256_add_epi8(sum, LD(dn + j-1));
+         sum = _mm256_add_epi8(sum, LD(dn + j));
+         sum = _mm256_add_epi8(sum, LD(dn + j+1));
+         alive = _mm256_cmpeq_epi8(LD(mid + j), one);
+         if (r == RULE_CONWAY) {
+            out = _mm256_or_si256(_mm256_cmpeq_epi8(sum, three),
+                  _mm256_and_si256(_mm256_cmpeq_epi8(sum, two), alive));
+            out = _mm256_and_si256(out, one);
+         } else {
+            out = _mm256_blendv_epi8(_mm256_shuffle_epi8(born, sum),
+                  _mm256_shuffle_epi8(stays, sum), alive);
+         }
+         _mm256_storeu_si256((__m256i*) (next + j), out);
+         total = _mm256_add_epi64(total, _mm256_sad_epu8(out, zero));
+      }
+      live += _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1)
+            + _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+      if (j < col1)
+         live += Halo_rows(w1, w2, m, n, i, i+1, j, col1, r);
+   }
+#  undef LD
+
+   return live;
+}  /* Halo_rows_avx2 */
+
+__attribute__((target("avx2,popcnt")))
+long Halo_update_avx2(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   RULE_DISPATCH(Halo_rows_avx2, w1, w2, m, n, row0, row1, col0, col1)
+}  /* Halo_update_avx2 */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_update_avx512, Halo_rows_avx512
+ * Purpose:    Halo_update, 64 cells per instruction
+ */
+__attribute__((target("avx512f,avx512bw,popcnt"), always_inline))
+static inline long Halo_rows_avx512(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1,
+      uint32_t r) {
+   const unsigned char *up, *mid, *dn;
+   unsigned char* next;
+   size_t stride = n + 2;
+   const __m512i one = _mm512_set1_epi8(1);
+   const __m512i two = _mm512_set1_epi8(2);
+   const __m512i three = _mm512_set1_epi8(3);
+   const __m512i born = _mm512_broadcast_i32x4(Rule_bytes(r, 0));
+   const __m512i stays = _mm512_broadcast_i32x4(Rule_bytes(r, 1));
+   __m512i sum, cell;
+   __mmask64 out;
+   int i, j;
+   long live = 0;
+
+#  define LD(p) _mm512_loadu_si512((const void*) (p))
+   for (i = row0; i < row1; i++) {
+      mid = (const unsigned char*) w1 + (i+1)*stride + 1;
+      up = mid - stride;
+      dn = mid + stride;
+      next = (unsigned char*) w2 + (i+1)*stride + 1;
+      for (j = col0; j + 64 <= col1; j += 64) {
+         sum = _mm512_add_epi8(LD(up + j-1), LD(up + j));
+         sum = _mm512_add_epi8(sum, LD(up + j+1));
+         sum = _mm512_add_epi8(sum, LD(mid + j-1));
+         sum = _mm512_add_epi8(sum, LD(mid + j+1));
+         sum = _mm512_add_epi8(sum, LD(dn + j-1));
+         sum = _mm512_add_epi8(sum, LD(dn + j));
+         sum = _mm512_add_epi8(sum, LD(dn + j+1));
+         cell = LD(mid + j);
+         if (r == RULE_CONWAY)
+            out = _mm512_cmpeq_epi8_mask(sum, three)
+                | (_mm512_cmpeq_epi8_mask(sum, two)
+                   & _mm512_test_epi8_mask(cell, cell));
+         else
+            out = _mm512_test_epi8_mask(
+                  _mm512_mask_blend_epi8(_mm512_test_epi8_mask(cell, cell),
+                     _mm512_shuffle_epi8(born, sum),
+                     _mm512_shuffle_epi8(stays, sum)), one);
+         _mm512_storeu_si512((void*) (next + j),
+               _mm512_maskz_mov_epi8(out, one));
+         live += __builtin_popcountll(out);
+      }
+      if (j < col1)
+         live += Halo_rows(w1, w2, m, n, i, i+1, j, col1, r);
+   }
+#  undef LD
+
+   return live;
+}  /* Halo_rows_avx512 */
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+long Halo_update_avx512(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   RULE_DISPATCH(Halo_rows_avx512, w1, w2, m, n, row0, row1, col0, col1)
+}  /* Halo_update_avx512 */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_update_avx2, Packed_rows_avx2
+ * Purpose:    Packed_update, 4 words (256 cells) per instruction
+ * Note:       Words whose neighbors wrap around the torus (the first
+ *             and last words of a row) go to the scalar kernel.
+ */
+__attribute__((target("avx2,popcnt"), always_inline))
+static inline long Packed_rows_avx2(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1,
+      uint32_t r) {
+   const uint64_t* cur = w1;
+   uint64_t* next = w2;
+   int words = Packed_units(n);
+   int last = words - 1;
+   int lo = col0 > 1 ? col0 : 1;
+   int hi = col1 < last ? col1 : last;
+   const uint64_t* rows[3];
+   __m256i c[3], we[3], ea[3], out;
+   int i, k, t;
+   long live = 0;
+
+#  define LD(p) _mm256_loadu_si256((const __m256i*) (p))
+   for (i = row0; i < row1; i++) {
+      rows[0] = cur + (size_t) ((i - 1 + m) % m)*words;
+      rows[1] = cur + (size_t) i*words;
+      rows[2] = cur + (size_t) ((i + 1) % m)*words;
+      k = col0;
+      if (k < lo)
+         live += Packed_rows(w1, w2, m, n, i, i+1, k, lo < col1 ? lo : col1,
+               r);
+      for (k = lo; k + 4 <= hi; k += 4) {
+         for (t = 0; t < 3; t++) {
+            c[t] = LD(rows[t] + k);
+            we[t] = _mm256_or_si256(_mm256_slli_epi64(c[t], 1),
+                  _mm256_srli_epi64(LD(rows[t] + k-1), 63));
+            ea[t] = _mm256_or_si256(_mm256_srli_epi64(c[t], 1),
+                  _mm256_slli_epi64(LD(rows[t] + k+1), 63));
+         }
+         PACKED_STEP(out, r, we[0], c[0], ea[0], we[1], c[1], ea[1],
+               we[2], c[2], ea[2]);
+         _mm256_storeu_si256((__m256i*) (next + (size_t) i*words + k), out);
+         live += __builtin_popcountll(_mm256_extract_epi64(out, 0))
+               + __builtin_popcountll(_mm256_extract_epi64(out, 1))
+               + __builtin_popcountll(_mm256_extract_epi64(out, 2))
+               + __builtin_popcountll(_mm256_extract_epi64(out, 3));
+      }
+      if (k < lo) k = lo;
+      if (k < col1)
+         live += Packed_rows(w1, w2, m, n, i, i+1, k, col1, r);
+   }
+#  undef LD
+
+   return live;
+}  /* Packed_rows_avx2 */
+
+__attribute__((target("avx2,popcnt")))
+long Packed_update_avx2(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   RULE_DISPATCH(Packed_rows_avx2, w1, w2, m, n, row0, row1, col0, col1)
+}  /* Packed_update_avx2 */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_update_avx512, Packed_rows_avx512
+ * Purpose:    Packed_update, 8 words (512 cells) per instruction
+ */
+__attribute__((target("avx512f,popcnt"), always_inline))
+static inline long Packed_rows_avx512(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1,
+      uint32_t r) {
+   const uint64_t* cur = w1;
+   uint64_t* next = w2;
+   int words = Packed_units(n);
+   int last = words - 1;
+   int lo = col0 > 1 ? col0 : 1;
+   int hi = col1 < last ? col1 : last;
+   const uint64_t* rows[3];
+   __m512i c[3], we[3], ea[3], out;
+   uint64_t words_out[8];
+   int i, k, t;
+   long live = 0;
+
+#  define LD(p) _mm512_loadu_si512((const void*) (p))
+   for (i = row0; i < row1; i++) {
+      rows[0] = cur + (size_t) ((i - 1 + m) % m)*words;
+      rows[1] = cur + (size_t) i*words;
+      rows[2] = cur + (size_t) ((i + 1) % m)*words;
+      k = col0;
+      if (k < lo)
+         live += Packed_rows(w1, w2, m, n, i, i+1, k, lo < col1 ? lo : col1,
+               r);
+      for (k = lo; k + 8 <= hi; k += 8) {
+         for (t = 0; t < 3; t++) {
+            c[t] = LD(rows[t] + k);
+            we[t] = _mm512_or_si512(_mm512_slli_epi64(c[t], 1),
+                  _mm512_srli_epi64(LD(rows[t] + k-1), 63));
+            ea[t] = _mm512_or_si512(_mm512_srli_epi64(c[t], 1),
+                  _mm512_slli_epi64(LD(rows[t] + k+1), 63));
+         }
+         PACKED_STEP(out, r, we[0], c[0], ea[0], we[1], c[1], ea[1],
+               we[2], c[2], ea[2]);
+         _mm512_storeu_si512((void*) (next + (size_t) i*words + k), out);
+         _mm512_storeu_si512((void*) words_out, out);
+         for (t = 0; t < 8; t++)
+            live += __builtin_popcountll(words_out[t]);
+      }
+      if (k < lo) k = lo;
+      if (k < col1)
+         live += Packed_rows(w1, w2, m, n, i, i+1, k, col1, r);
+   }
+#  undef LD
+
+   return live;
+}  /* Packed_rows_avx512 */
+
+__attribute__((target("avx512f,popcnt")))
+long Packed_update_avx512(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   RULE_DISPATCH(Packed_rows_avx512, w1, w2, m, n, row0, row1, col0, col1)
+}  /* Packed_update_avx512 */
+#endif
+
+#if defined(__aarch64__)
+/*---------------------------------------------------------------------
+ * Function:   Has_neon
+ * Purpose:    Ask the kernel's HWCAPs whether the host has Advanced
+ *             SIMD.  It is part of the ARMv8-A baseline, so without
+ *             HWCAPs assume that it does.
+ */
+int Has_neon(void) {
+#  ifdef HWCAP_ASIMD
+   return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#  else
+   return 1;
+#  endif
+}  /* Has_neon */
+
+/*---------------------------------------------------------------------
+ * Function:   Halo_update_neon, Halo_rows_neon
+ * Purpose:    Halo_update, 16 cells per instruction
+ */
+static inline __attribute__((always_inline))
+long Halo_rows_neon(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1,
+      uint32_t r) {
+   const unsigned char *up, *mid, *dn;
+   unsigned char* next;
+   size_t stride = n + 2;
+   const uint8x16_t one = vdupq_n_u8(1);
+   const uint8x16_t two = vdupq_n_u8(2);
+   const uint8x16_t three = vdupq_n_u8(3);
+   unsigned char born_t[16], stays_t[16];
+   uint8x16_t born, stays, sum, cell, out;
+   int k;
+   int i, j;
+   long live = 0;
+
+   for (k = 0; k < 16; k++) {
+      born_t[k] = k <= 8 ? RULE_NEXT(r, 0, k) : 0;
+      stays_t[k] = k <= 8 ? RULE_NEXT(r, 1, k) : 0;
+   }
+   born = vld1q_u8(born_t);
+   stays = vld1q_u8(stays_t);
+
+   for (i = row0; i < row1; i++) {
+      mid = (const unsigned char*) w1 + (i+1)*stride + 1;
+      up = mid - stride;
+      dn = mid + stride;
+      next = (unsigned char*) w2 + (i+1)*stride + 1;
+      for (j = col0; j + 16 <= col1; j += 16) {
+         sum = vaddq_u8(vld1q_u8(up + j-1), vld1q_u8(up + j));
+         sum = vaddq_u8(sum, vld1q_u8(up + j+1));
+         sum = vaddq_u8(sum, vld1q_u8(mid + j-1));
+         sum = vaddq_u8(sum, vld1q_u8(mid + j+1));
+         sum = vaddq_u8(sum, vld1q_u8(dn + j-1));
+         sum = vaddq_u8(sum, vld1q_u8(dn + j));
+         sum = vaddq_u8(sum, vld1q_u8(dn + j+1));
+         cell = vld1q_u8(mid + j);
+         if (r == RULE_CONWAY) {
+            out = vorrq_u8(vceqq_u8(sum, three),
+                  vandq_u8(vceqq_u8(sum, two), vtstq_u8(cell, cell)));
+            out = vandq_u8(out, one);
+         } else {
+            out = vbslq_u8(vtstq_u8(cell, cell), vqtbl1q_u8(stays, sum),
+                  vqtbl1q_u8(born, sum));
+         }
+         vst1q_u8(next + j, out);
+         live += vaddvq_u8(out);
+      }
+      if (j < col1)
+         live += Halo_rows(w1, w2, m, n, i, i+1, j, col1, r);
+   }
+
+   return live;
+}  /* Halo_rows_neon */
+
+long Halo_update_neon(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   RULE_DISPATCH(Halo_rows_neon, w1, w2, m, n, row0, row1, col0, col1)
+}  /* Halo_update_neon */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_update_neon, Packed_rows_neon
+ * Purpose:    Packed_update, 2 words (128 cells) per instruction
+ */
+static inline __attribute__((always_inline))
+long Packed_rows_neon(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1,
+      uint32_t r) {
+   const uint64_t* cur = w1;
+   uint64_t* next = w2;
+   int words = Packed_units(n);
+   int last = words - 1;
+   int lo = col0 > 1 ? col0 : 1;
+   int hi = col1 < last ? col1 : last;
+   const uint64_t* rows[3];
+   uint64x2_t c[3], we[3], ea[3], out;
+   int i, k, t;
+   long live = 0;
+
+   for (i = row0; i < row1; i++) {
+      rows[0] = cur + (size_t) ((i - 1 + m) % m)*words;
+      rows[1] = cur + (size_t) i*words;
+      rows[2] = cur + (size_t) ((i + 1) % m)*words;
+      k = col0;
+      if (k < lo)
+         live += Packed_rows(w1, w2, m, n, i, i+1, k, lo < col1 ? lo : col1,
+               r);
+      for (k = lo; k + 2 <= hi; k += 2) {
+         for (t = 0; t < 3; t++) {
+            c[t] = vld1q_u64(rows[t] + k);
+            we[t] = vorrq_u64(vshlq_n_u64(c[t], 1),
+                  vshrq_n_u64(vld1q_u64(rows[t] + k-1), 63));
+            ea[t] = vorrq_u64(vshrq_n_u64(c[t], 1),
+                  vshlq_n_u64(vld1q_u64(rows[t] + k+1), 63));
+         }
+         PACKED_STEP(out, r, we[0], c[0], ea[0], we[1], c[1], ea[1],
+               we[2], c[2], ea[2]);
+         vst1q_u64(next + (size_t) i*words + k, out);
+         live += vaddvq_u8(vcntq_u8(vreinterpretq_u8_u64(out)));
+      }
+      if (k < lo) k = lo;
+      if (k < col1)
+         live += Packed_rows(w1, w2, m, n, i, i+1, k, col1, r);
+   }
+
+   return live;
+}  /* Packed_rows_neon */
+
+long Packed_update_neon(const void* w1, void* w2, int m, int n,
+      int row0, int row1, int col0, int col1, uint32_t r) {
+   RULE_DISPATCH(Packed_rows_neon, w1, w2, m, n, row0, row1, col0, col1)
+}  /* Packed_update_neon */
+#endif
+
+/*-------------------------------------------------------------------
+ * Function:    Barrier
+ * Purpose:     Wait for all the threads to finish the current
+ *              generation, and start the next one
+ * In arg:      rank
+ * Global var:  barrier
+ */
+void *Barrier(void* rank) {
+   PROF_START(t0);
+   barrier->wait((long) rank, Next_generation);
+   PROF_STOP(PROF_WAIT, t0, curr_gen, -1);
+
+   return NULL;
+}  /* Barrier */
+
+/*-------------------------------------------------------------------
+ * Function:    Next_generation
+ * Purpose:     Make the generation the threads just computed the
+ *              current one, and pass it to the writer thread.  Run by
+ *              exactly one thread while the others wait at the
+ *              barrier.
+ * Global var:  w1, w2, curr_gen, live_count, thread_live, BREAK,
+ *              cycle_max, cycle_period, view_due, view_next
+ *
+ * Note:        With --cycles, a generation that repeats one of the
+ *              last cycle_max is the last one, and is printed as the
+ *              final generation.  If the world dies, the generation
+ *              before, which is still in w2, is printed as the final
+ *              one instead.
+ */
+void Next_generation(void) {
+   void *tmp;
+   long last_live = live_count;
+   int t;
+   PROF_START(t0);
+
+   tmp = w1;
+   w1 = w2;
+   w2 = tmp;
+   if (halo_depth > 1) {
+      Deep_generations();
+   } else {
+      curr_gen++;
+      live_count = 0;
+      for (t = 0; t < thread_count; t++)
+         live_count += thread_live[t].value;
+   }
+   Bench_stamp();
+   if (view_due) View_frame();
+   view_due = view_h > 0 && Now() >= view_next;
+   if (sched_steal) Reset_tile_queues();
+   if (active) {
+      tmp = changed[0];
+      changed[0] = changed[1];
+      changed[1] = tmp;
+   }
+
+   if (cycle_max > 0 && live_count > 0)
+      cycle_period = Find_cycle(World_hash(), curr_gen, live_count,
+            first_gen, recent_hash, recent_live);
+
+   if(live_count > 0){
+      if (Want_output(curr_gen, curr_gen == max_gens || cycle_period > 0))
+         Output_world(w1, curr_gen, live_count);
+      if (cycle_period > 0) BREAK = 1;
+   } else {
+      BREAK = 1;
+      if (output_mode == OUTPUT_FINAL && halo_depth == 1)
+         Output_world(w2, curr_gen - 1, last_live);
+   }
+   PROF_STOP(PROF_SERIAL, t0, curr_gen, -1);
+}  /* Next_generation */
+
+/*-------------------------------------------------------------------
+ * Function:    Mutex_barrier_wait
+ * Purpose:     Barrier built from a mutex and a condition variable.
+ *              The last thread to arrive runs serial while it holds
+ *              the mutex.
+ * In args:     rank, serial
+ * Global var:  thread_count, barrier_thread_count, barrier_mutex,
+ *              ok_to_proceed
+ */
+void Mutex_barrier_wait(long rank, void (*serial)(void)) {
+   pthread_mutex_lock(&barrier_mutex);
+   barrier_thread_count++;
+   if (barrier_thread_count == thread_count) {
+      serial();
+      barrier_thread_count = 0;
+      barrier_cycle++;
       pthread_cond_broadcast(&ok_to_proceed);
    } else {
-      while (pthread_cond_wait(&ok_to_proceed,
-                &barrier_mutex) != 0);
+      int my_cycle = barrier_cycle;
+      while (my_cycle == barrier_cycle)
+         pthread_cond_wait(&ok_to_proceed, &barrier_mutex);
       // Mutex is relocked at this point.
    }
    pthread_mutex_unlock(&barrier_mutex);
+}  /* Mutex_barrier_wait */
+
+void Mutex_barrier_init(int thread_count) {
+   pthread_mutex_init(&barrier_mutex, NULL);
+   pthread_cond_init(&ok_to_proceed, NULL);
+}  /* Mutex_barrier_init */
+
+void Mutex_barrier_destroy(void) {
+   pthread_mutex_destroy(&barrier_mutex);
+   pthread_cond_destroy(&ok_to_proceed);
+}  /* Mutex_barrier_destroy */
+
+/*-------------------------------------------------------------------
+ * Function:    Spin_pause
+ * Purpose:     Body of a spin-wait loop.  Tells the core we're
+ *              spinning, and every SPIN_YIELD spins lets another
+ *              thread run, so that oversubscribed runs (more threads
+ *              than cores) still make progress.
+ * In/out arg:  spins_p:  number of spins so far
+ */
+static inline void Spin_pause(int* spins_p) {
+#  if defined(__x86_64__) || defined(__i386__)
+   _mm_pause();
+#  elif defined(__aarch64__)
+   __asm__ __volatile__("yield");
+#  endif
+   if (++*spins_p % SPIN_YIELD == 0) sched_yield();
+}  /* Spin_pause */
+
+/*-------------------------------------------------------------------
+ * Function:    Sense_barrier_wait
+ * Purpose:     Sense-reversing spin barrier.  Each thread flips its
+ *              private sense and counts itself in with an atomic add.
+ *              The last thread to arrive resets the count, runs
+ *              serial, and releases the others by publishing its
+ *              sense.  The others spin on the shared sense without
+ *              taking any locks.
+ * In args:     rank, serial
+ * Global var:  sense_count, sense_flag, local_sense
+ */
+void Sense_barrier_wait(long rank, void (*serial)(void)) {
+   int my_sense = local_sense[rank].value = !local_sense[rank].value;
+   int spins = 0;
+
+   if (atomic_fetch_add(&sense_count, 1) == thread_count - 1) {
+      atomic_store_explicit(&sense_count, 0, memory_order_relaxed);
+      serial();
+      atomic_store_explicit(&sense_flag, my_sense, memory_order_release);
+   } else {
+      while (atomic_load_explicit(&sense_flag, memory_order_acquire)
+            != my_sense)
+         Spin_pause(&spins);
+   }
+}  /* Sense_barrier_wait */
+
+void Sense_barrier_init(int thread_count) {
+   local_sense = calloc(thread_count, sizeof(Padded_int));
+   atomic_init(&sense_count, 0);
+   atomic_init(&sense_flag, 0);
+   atomic_init(&parked, 0);
+   pthread_mutex_init(&barrier_mutex, NULL);
+   pthread_cond_init(&ok_to_proceed, NULL);
+}  /* Sense_barrier_init */
+
+void Sense_barrier_destroy(void) {
+   free(local_sense);
+   pthread_mutex_destroy(&barrier_mutex);
+   pthread_cond_destroy(&ok_to_proceed);
+}  /* Sense_barrier_destroy */
+
+/*-------------------------------------------------------------------
+ * Function:    Hybrid_barrier_wait
+ * Purpose:     Sense-reversing barrier that spins for a while and
+ *              then parks on ok_to_proceed.  Good when the threads
+ *              arrive close together most of the time, but a slow
+ *              generation shouldn't burn every core.
+ * In args:     rank, serial
+ * Global var:  sense_count, sense_flag, local_sense, parked,
+ *              barrier_mutex, ok_to_proceed
+ *
+ * Note:        A waiter counts itself in parked before its last look
+ *              at sense_flag, and the releaser stores sense_flag
+ *              before it looks at parked.  Both are sequentially
+ *              consistent, so either the waiter sees the new sense
+ *              or the releaser sees the waiter and broadcasts.
+ */
+void Hybrid_barrier_wait(long rank, void (*serial)(void)) {
+   int my_sense = local_sense[rank].value = !local_sense[rank].value;
+   int spins = 0;
+
+   if (atomic_fetch_add(&sense_count, 1) == thread_count - 1) {
+      atomic_store_explicit(&sense_count, 0, memory_order_relaxed);
+      serial();
+      atomic_store(&sense_flag, my_sense);
+      if (atomic_load(&parked) > 0) {
+         pthread_mutex_lock(&barrier_mutex);
+         pthread_cond_broadcast(&ok_to_proceed);
+         pthread_mutex_unlock(&barrier_mutex);
+      }
+      return;
+   }
+
+   while (spins < HYBRID_SPINS) {
+      if (atomic_load_explicit(&sense_flag, memory_order_acquire)
+            == my_sense)
+         return;
+      Spin_pause(&spins);
+   }
+
+   pthread_mutex_lock(&barrier_mutex);
+   atomic_fetch_add(&parked, 1);
+   while (atomic_load(&sense_flag) != my_sense)
+      pthread_cond_wait(&ok_to_proceed, &barrier_mutex);
+   atomic_fetch_sub(&parked, 1);
+   pthread_mutex_unlock(&barrier_mutex);
+}  /* Hybrid_barrier_wait */
+
+/*-------------------------------------------------------------------
+ * Function:    Dissem_barrier_wait
+ * Purpose:     Dissemination barrier.  In round k each thread signals
+ *              thread rank + 2^k and waits to be signalled by thread
+ *              rank - 2^k, so after ceil(log2(thread_count)) rounds
+ *              every thread has heard from every other, and no flag
+ *              is written by more than one thread.  There is no last
+ *              thread to run serial, so thread 0 runs it between two
+ *              episodes of the barrier.
+ * In args:     rank, serial
+ * Global var:  dissem_nodes, dissem_rounds
+ *
+ * Note:        Each thread alternates between two sets of flags (its
+ *              parity) and flips the value it writes (its sense)
+ *              every other episode, so the flags never need to be
+ *              reset.  (Hensgen, Finkel and Manber.)
+ */
+void Dissem_barrier_wait(long rank, void (*serial)(void)) {
+   Dissem_episode(rank);
+   if (rank == 0) serial();
+   Dissem_episode(rank);
+}  /* Dissem_barrier_wait */
+
+void Dissem_episode(long rank) {
+   Dissem_node* me = &dissem_nodes[rank];
+   int round, dist, spins = 0;
+   long partner;
+
+   for (round = 0, dist = 1; round < dissem_rounds; round++, dist *= 2) {
+      partner = (rank + dist) % thread_count;
+      atomic_store_explicit(&dissem_nodes[partner].flags[me->parity][round],
+            me->sense, memory_order_release);
+      while (atomic_load_explicit(&me->flags[me->parity][round],
+               memory_order_acquire) != me->sense)
+         Spin_pause(&spins);
+   }
+   if (me->parity == 1) me->sense = !me->sense;
+   me->parity = 1 - me->parity;
+}  /* Dissem_episode */
+
+void Dissem_barrier_init(int thread_count) {
+   int rank, p, round;
+
+   for (dissem_rounds = 0; (1 << dissem_rounds) < thread_count;
+         dissem_rounds++);
+   dissem_nodes = aligned_alloc(CACHE_LINE,
+         thread_count*sizeof(Dissem_node));
+   for (rank = 0; rank < thread_count; rank++) {
+      for (p = 0; p < 2; p++)
+         for (round = 0; round < MAX_ROUNDS; round++)
+            atomic_init(&dissem_nodes[rank].flags[p][round], 0);
+      dissem_nodes[rank].parity = 0;
+      dissem_nodes[rank].sense = 1;
+   }
+}  /* Dissem_barrier_init */
+
+void Dissem_barrier_destroy(void) {
+   free(dissem_nodes);
+}  /* Dissem_barrier_destroy */
+
+/*---------------------------------------------------------------------
+ * Function:   Find_barrier
+ * Purpose:    Look up a barrier by name
+ * In arg:     name
+ * Ret val:    The barrier, or NULL if there is no barrier called name
+ */
+const Barrier_type* Find_barrier(const char name[]) {
+   int b;
+
+   for (b = 0; b < sizeof(barriers)/sizeof(barriers[0]); b++)
+      if (strcmp(barriers[b].name, name) == 0)
+         return &barriers[b];
+   return NULL;
+}  /* Find_barrier */
+
+/*---------------------------------------------------------------------
+ * Function:   Pool_worker
+ * Purpose:    Thread function of a pool member:  wait for a job, run
+ *             it, and report back, until the pool is destroyed
+ * In arg:     arg:  the member's Pool_member
+ */
+static void* Pool_worker(void* arg) {
+   Pool_member* me = arg;
+   Pool* pool = me->pool;
+   long seen = 0;
+   void* (*job)(void*);
+   void (*task)(void*, long);
+   void* task_arg;
+
+   pthread_mutex_lock(&pool->mutex);
+   while (1) {
+      while (pool->jobs == seen && !pool->stop)
+         pthread_cond_wait(&pool->start, &pool->mutex);
+      if (pool->stop) break;
+      seen = pool->jobs;
+      job = pool->job;
+      task = pool->task;
+      task_arg = pool->arg;
+      pthread_mutex_unlock(&pool->mutex);
+
+      if (task != NULL)
+         task(task_arg, me->rank);
+      else
+         job((void*) me->rank);
+
+      pthread_mutex_lock(&pool->mutex);
+      if (--pool->running == 0)
+         pthread_cond_signal(&pool->done);
+   }
+   pthread_mutex_unlock(&pool->mutex);
+
+   return NULL;
+}  /* Pool_worker */
+
+/*---------------------------------------------------------------------
+ * Function:   Pool_create
+ * Purpose:    Start a pool of threads, which wait for Pool_run
+ * In arg:     threads:  number of threads
+ * Ret val:    The pool, or NULL if there's no memory for it or a
+ *             thread can't be started
+ */
+Pool* Pool_create(int threads) {
+   Pool* pool = malloc(sizeof(Pool));
+   long rank;
+
+   if (pool == NULL) return NULL;
+   pool->threads = threads;
+   pool->handles = malloc(threads*sizeof(pthread_t));
+   pool->members = malloc(threads*sizeof(Pool_member));
+   if (pool->handles == NULL || pool->members == NULL) {
+      free(pool->handles);
+      free(pool->members);
+      free(pool);
+      return NULL;
+   }
+   pool->jobs = 0;
+   pool->running = 0;
+   pool->stop = 0;
+   pthread_mutex_init(&pool->mutex, NULL);
+   pthread_cond_init(&pool->start, NULL);
+   pthread_cond_init(&pool->done, NULL);
+   for (rank = 0; rank < threads; rank++) {
+      pool->members[rank].pool = pool;
+      pool->members[rank].rank = rank;
+      if (pthread_create(&pool->handles[rank], NULL, Pool_worker,
+               &pool->members[rank]) != 0) {
+         pool->threads = rank;      /* stop the ones that started */
+         Pool_destroy(pool);
+         return NULL;
+      }
+   }
+
+   return pool;
+}  /* Pool_create */
+
+/*---------------------------------------------------------------------
+ * Function:   Pool_run
+ * Purpose:    Run job(rank) in every thread of the pool, and wait for
+ *             all of them to return
+ * In args:    pool, job
+ *
+ * Note:       The threads are kept between jobs, so a caller that
+ *             runs many simulations only starts them once.
+ */
+void Pool_run(Pool* pool, void* (*job)(void* rank)) {
+   pthread_mutex_lock(&pool->mutex);
+   pool->job = job;
+   pool->task = NULL;
+   pool->running = pool->threads;
+   pool->jobs++;
+   pthread_cond_broadcast(&pool->start);
+   while (pool->running > 0)
+      pthread_cond_wait(&pool->done, &pool->mutex);
+   pthread_mutex_unlock(&pool->mutex);
+}  /* Pool_run */
+
+/*---------------------------------------------------------------------
+ * Function:   Pool_run_task
+ * Purpose:    Pool_run for a job that isn't about the globals:  run
+ *             task(arg, rank) in every thread of the pool, and wait
+ *             for all of them to return
+ * In args:    pool, task, arg
+ */
+void Pool_run_task(Pool* pool, void (*task)(void* arg, long rank),
+      void* arg) {
+   pthread_mutex_lock(&pool->mutex);
+   pool->task = task;
+   pool->arg = arg;
+   pool->running = pool->threads;
+   pool->jobs++;
+   pthread_cond_broadcast(&pool->start);
+   while (pool->running > 0)
+      pthread_cond_wait(&pool->done, &pool->mutex);
+   pthread_mutex_unlock(&pool->mutex);
+}  /* Pool_run_task */
+
+/*---------------------------------------------------------------------
+ * Function:   Pool_destroy
+ * Purpose:    Stop and join the threads of an idle pool, and free it
+ * In arg:     pool
+ */
+void Pool_destroy(Pool* pool) {
+   int rank;
+
+   pthread_mutex_lock(&pool->mutex);
+   pool->stop = 1;
+   pthread_cond_broadcast(&pool->start);
+   pthread_mutex_unlock(&pool->mutex);
+   for (rank = 0; rank < pool->threads; rank++)
+      pthread_join(pool->handles[rank], NULL);
+
+   pthread_mutex_destroy(&pool->mutex);
+   pthread_cond_destroy(&pool->start);
+   pthread_cond_destroy(&pool->done);
+   free(pool->handles);
+   free(pool->members);
+   free(pool);
+}  /* Pool_destroy */
+
+/*---------------------------------------------------------------------
+ * Function:   Pipe_horizon
+ * Purpose:    Find how far the tiles may run ahead once generation
+ *             done is complete
+ * In arg:     done
+ * Ret val:    The last generation any tile may compute
+ * Global var: max_gens
+ *
+ * Note:       Generation g is in pipe_worlds[g % 2], and a tile that
+ *             computes g+2 overwrites it, so no tile may pass g+1
+ *             until g has been copied for the writer.  The ring of
+ *             population counts holds PIPE_DEPTH generations.
+ */
+static long Pipe_horizon(long done) {
+   long limit = done + PIPE_DEPTH;
+   long g;
+
+   if (limit > max_gens) limit = max_gens;
+   for (g = done + 1; g < limit; g++)
+      if (Want_output(g, g == max_gens)) return g + 1;
+   return limit;
+}  /* Pipe_horizon */
+
+/*---------------------------------------------------------------------
+ * Function:   Pipe_start
+ * Purpose:    Set up the pipeline scheduler:  every tile is at
+ *             generation 0, which is in w1
+ * Global var: tile_gen, pipe_worlds, pipe_limit, pipe_live,
+ *             pipe_tiles, pipe_stop, pipe_done, curr_gen
+ */
+void Pipe_start(void) {
+   int t;
+
+   tile_gen = aligned_alloc(CACHE_LINE, tile_count*sizeof(Tile_clock));
+   for (t = 0; t < tile_count; t++)
+      atomic_init(&tile_gen[t].value, curr_gen);
+   for (t = 0; t < PIPE_DEPTH; t++) {
+      atomic_init(&pipe_live[t], 0);
+      atomic_init(&pipe_tiles[t], 0);
+   }
+   pipe_worlds[curr_gen % 2] = w1;
+   pipe_worlds[(curr_gen + 1) % 2] = w2;
+   pipe_done = curr_gen;
+   atomic_init(&pipe_limit, Pipe_horizon(curr_gen));
+   atomic_init(&pipe_stop, 0);
+   pthread_mutex_init(&pipe_mutex, NULL);
+   pthread_cond_init(&pipe_turn, NULL);
+}  /* Pipe_start */
+
+/*---------------------------------------------------------------------
+ * Function:   Pipe_finish
+ * Purpose:    Leave the last complete generation in w1, and free the
+ *             pipeline's state
+ * Global var: w1, w2, pipe_worlds, curr_gen, tile_gen
+ */
+void Pipe_finish(void) {
+   w1 = pipe_worlds[curr_gen % 2];
+   w2 = pipe_worlds[(curr_gen + 1) % 2];
+   free(tile_gen);
+   pthread_mutex_destroy(&pipe_mutex);
+   pthread_cond_destroy(&pipe_turn);
+}  /* Pipe_finish */
+
+/*---------------------------------------------------------------------
+ * Function:   Tile_ready
+ * Purpose:    Check whether tile t can compute generation gen+1:  all
+ *             its neighbors must have reached gen
+ * In args:    t, gen
+ *
+ * Note:       A neighbor that has reached gen has also finished
+ *             reading gen-1, which tile t is about to overwrite.
+ */
+static int Tile_ready(int t, long gen) {
+   int k;
+
+   for (k = 0; k < 9; k++)
+      if (atomic_load_explicit(&tile_gen[tile_nbrs[9*t + k]].value,
+               memory_order_acquire) < gen)
+         return 0;
+   return 1;
+}  /* Tile_ready */
+
+/*---------------------------------------------------------------------
+ * Function:   Play_pipeline
+ * Purpose:    Thread function of the pipeline scheduler.  Sweep over
+ *             the thread's own tiles, advancing every tile whose
+ *             neighbors have caught up, until they have all reached
+ *             max_gens or the world has died.
+ * In arg:     rank
+ * Global var: tiles, first_tile, tile_gen, pipe_worlds, pipe_limit,
+ *             pipe_live, pipe_tiles, pipe_stop
+ *
+ * Note:       A tile keeps going for as long as it can, so it does
+ *             several generations while it's in cache when its
+ *             neighbors are ahead.  The thread that finishes the last
+ *             tile of a generation does the serial work for it.
+ */
+void* Play_pipeline(void* rank) {
+   long my_rank = (long) rank;
+   long gen, live;
+   int t, slot, spins = 0, busy, left;
+#  ifdef LIFE_PROFILE
+   double idle = 0;     /* when the thread last ran out of tiles */
+#  endif
+
+   PROF_THREAD(my_rank);
+   while (!atomic_load_explicit(&pipe_stop, memory_order_relaxed)) {
+      busy = left = 0;
+      for (t = first_tile[my_rank]; t < first_tile[my_rank+1]; t++) {
+         gen = atomic_load_explicit(&tile_gen[t].value,
+               memory_order_relaxed);
+         while (gen < atomic_load_explicit(&pipe_limit,
+                  memory_order_acquire) && Tile_ready(t, gen)) {
+#           ifdef LIFE_PROFILE
+            if (idle > 0) Prof_add(PROF_WAIT, idle, gen, -1);
+            idle = 0;
+#           endif
+            PROF_START(t0);
+            live = Step_tile(pipe_worlds[gen % 2],
+                  pipe_worlds[(gen + 1) % 2], &tiles[t]);
+            PROF_STOP(PROF_COMPUTE, t0, gen + 1, t);
+            gen++;
+            atomic_store_explicit(&tile_gen[t].value, gen,
+                  memory_order_release);
+            slot = gen % PIPE_DEPTH;
+            atomic_fetch_add(&pipe_live[slot], live);
+            if (atomic_fetch_add(&pipe_tiles[slot], 1) == tile_count - 1)
+               Pipe_generation(gen);
+            busy = 1;
+         }
+         if (gen < max_gens) left = 1;
+      }
+      if (!left) break;
+#     ifdef LIFE_PROFILE
+      if (!busy && idle == 0) idle = Now();
+#     endif
+      if (!busy) Spin_pause(&spins);
+   }
+#  ifdef LIFE_PROFILE
+   if (idle > 0) Prof_add(PROF_WAIT, idle, curr_gen, -1);
+#  endif
+
+   return NULL;
+}  /* Play_pipeline */
+
+/*---------------------------------------------------------------------
+ * Function:   Pipe_generation
+ * Purpose:    Serial work for a generation that every tile has
+ *             finished:  pass it to the writer thread, stop if the
+ *             world has died, and let the tiles run further ahead
+ * In arg:     gen
+ * Global var: pipe_done, pipe_live, pipe_tiles, pipe_limit, pipe_stop,
+ *             curr_gen, live_count, BREAK
+ *
+ * Note:       Generations can finish while the one before is still
+ *             being output, so they take turns on pipe_mutex, in
+ *             order.
+ */
+void Pipe_generation(long gen) {
+   int slot = gen % PIPE_DEPTH;
+   long live;
+   PROF_START(t0);
+
+   pthread_mutex_lock(&pipe_mutex);
+   while (pipe_done != gen - 1)
+      pthread_cond_wait(&pipe_turn, &pipe_mutex);
+
+   live = atomic_exchange(&pipe_live[slot], 0);
+   atomic_store(&pipe_tiles[slot], 0);
+   if (!atomic_load(&pipe_stop)) {
+      curr_gen = gen;
+      live_count = live;
+      Bench_stamp();
+      if (live > 0) {
+         if (Want_output(gen, gen == max_gens))
+            Output_world(pipe_worlds[gen % 2], gen, live);
+      } else {
+         BREAK = 1;
+         atomic_store(&pipe_stop, 1);
+      }
+   }
+   pipe_done = gen;
+   atomic_store_explicit(&pipe_limit, Pipe_horizon(gen),
+         memory_order_release);
+
+   pthread_cond_broadcast(&pipe_turn);
+   pthread_mutex_unlock(&pipe_mutex);
+   PROF_STOP(PROF_SERIAL, t0, gen, -1);
+}  /* Pipe_generation */
+
+/*---------------------------------------------------------------------
+ * Function:   World_alloc
+ * Purpose:    Allocate a zeroed world, without touching its pages
+ * In arg:     size:  bytes
+ * Ret val:    The world
+ * Global var: huge_pages
+ *
+ * Note:       The pages come straight from mmap, so they're placed
+ *             on the node of the thread that first writes them (see
+ *             Place_thread).  With huge_pages, or for a world of
+ *             HUGE_MIN bytes or more, the kernel is asked to back
+ *             them with transparent huge pages, which cuts TLB misses
+ *             on big worlds.  mmap's pages are aligned, so the rows
+ *             start on a cache line whenever a row is a whole number
+ *             of them.
+ */
+void* World_alloc(size_t size) {
+   void* w = mmap(NULL, size, PROT_READ | PROT_WRITE,
+         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+   if (w == MAP_FAILED) {
+      fprintf(stderr, "Can't allocate a world of %zu bytes\n", size);
+      exit(1);
+   }
+#  ifdef MADV_HUGEPAGE
+   if (huge_pages || size >= HUGE_MIN) madvise(w, size, MADV_HUGEPAGE);
+#  endif
+   return w;
+}  /* World_alloc */
+
+/*---------------------------------------------------------------------
+ * Function:   World_free
+ * Purpose:    Free a world allocated by World_alloc
+ * In args:    w, size
+ */
+void World_free(void* w, size_t size) {
+   munmap(w, size);
+}  /* World_free */
+
+/*---------------------------------------------------------------------
+ * Function:   Find_cpus
+ * Purpose:    List the cores the threads are pinned to:  the cores
+ *             this process may run on, grouped by NUMA node when
+ *             libnuma is there
+ * Global var: cpus, cpu_count
+ *
+ * Note:       Ranks go along the rows of the r x c thread grid, and
+ *             the world is stored row by row, so handing out the
+ *             cores in order puts whole bands of block rows, and the
+ *             memory under them, on each node.  Neighboring blocks
+ *             share a node except along the band edges.
+ */
+void Find_cpus(void) {
+   cpu_set_t set;
+   int cpu;
+#  ifdef USE_NUMA
+   int i, j, tmp;
+#  endif
+
+   CPU_ZERO(&set);
+   sched_getaffinity(0, sizeof(set), &set);
+   cpus = malloc(CPU_SETSIZE*sizeof(int));
+   cpu_count = 0;
+   for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set)) cpus[cpu_count++] = cpu;
+
+#  ifdef USE_NUMA
+   /* Insertion sort by node, keeping the order within a node */
+   if (numa_available() >= 0)
+      for (i = 1; i < cpu_count; i++)
+         for (j = i; j > 0 && numa_node_of_cpu(cpus[j-1])
+               > numa_node_of_cpu(cpus[j]); j--) {
+            tmp = cpus[j];
+            cpus[j] = cpus[j-1];
+            cpus[j-1] = tmp;
+         }
+#  endif
+}  /* Find_cpus */
+
+/*---------------------------------------------------------------------
+ * Function:   Place_thread
+ * Purpose:    First job of the pool:  pin the thread to its core, and
+ *             zero its tiles of both worlds, so that their pages are
+ *             allocated on its node
+ * In arg:     rank
+ * Global var: pin_threads, numa_place, cpus, tiles, first_tile, w1, w2
+ *
+ * Note:       Linux places a page on the node of the thread that
+ *             first touches it.  With numa_place the thread's rows are
+ *             also bound to its node with mbind (through libnuma), so
+ *             they stay there even if the kernel would rather move
+ *             them.  Pages shared by two threads' blocks go to
+ *             whichever gets there first.
+ */
+void* Place_thread(void* rank) {
+   long my_rank = (long) rank;
+   const Tile* tile;
+   size_t start, end;
+   int t, i;
+   cpu_set_t set;
+
+   if (pin_threads) {
+      CPU_ZERO(&set);
+      CPU_SET(cpus[my_rank % cpu_count], &set);
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+   }
 
+   for (t = first_tile[my_rank]; t < first_tile[my_rank+1]; t++) {
+      tile = &tiles[t];
+#     ifdef USE_NUMA
+      if (numa_place) {
+         size_t page = numa_pagesize();
+         start = engine->offset(m, n, tile->row0, tile->col0) & ~(page - 1);
+         end = engine->offset(m, n, tile->row1 - 1, tile->col1);
+         numa_tonode_memory((char*) w1 + start, end - start,
+               numa_node_of_cpu(cpus[my_rank % cpu_count]));
+         numa_tonode_memory((char*) w2 + start, end - start,
+               numa_node_of_cpu(cpus[my_rank % cpu_count]));
+      }
+#     endif
+      for (i = tile->row0; i < tile->row1; i++) {
+         start = engine->offset(m, n, i, tile->col0);
+         end = engine->offset(m, n, i, tile->col1);
+         memset((char*) w1 + start, 0, end - start);
+         memset((char*) w2 + start, 0, end - start);
+      }
+   }
 
    return NULL;
-}  /* Barrier */
\ No newline at end of file
+}  /* Place_thread */
+
+#ifdef USE_MPI
+/*---------------------------------------------------------------------
+ * MPI backend
+ *
+ * Process (pi,pj) of the r x c process grid holds block (pi,pj) of
+ * the world, and nothing else, as a small halo world:  mpi_rows x
+ * mpi_cols cells with a one cell ghost border.  Every generation the
+ * border is filled by non-blocking messages from the eight
+ * neighboring processes (rows and columns from the sides, single
+ * cells from the corners) while the interior of the block, which
+ * doesn't need the border, is computed.  Then the frame of cells
+ * next to the border is computed, and the population is added up
+ * with an MPI_Allreduce, which also tells every process when the
+ * world has died.
+ *
+ * Process 0 reads or generates generation 0 and prints the worlds,
+ * one row at a time, through the "mpi" engine below:  its store_row
+ * sends the pieces of a row to the processes that own them, and its
+ * load_row collects them.  So no process ever holds the whole world.
+ */
+int     mpi_rank;
+int     mpi_row0, mpi_col0;    /* where this process's block starts */
+int     mpi_rows, mpi_cols;    /* and its size */
+Update_fn* mpi_update;         /* halo kernel for the blocks */
+
+/* Sends in direction d carry tag d, and arrive from direction
+   7 - d (N 0, W 1, NW 2, NE 3, SW 4, SE 5, E 6, S 7) */
+static const int mpi_dirs[8][2] = {
+   {-1, 0}, {0, -1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1}, {0, 1}, {1, 0}
+};
+
+/*---------------------------------------------------------------------
+ * Function:   Block_owner
+ * Purpose:    Which of the ranges of Block_range(total, parts, ...)
+ *             holds item idx
+ */
+static int Block_owner(int total, int parts, int idx) {
+   int quotient = total/parts;
+   int remainder = total % parts;
+
+   if (idx < remainder*(quotient + 1)) return idx/(quotient + 1);
+   return remainder + (idx - remainder*(quotient + 1))/quotient;
+}  /* Block_owner */
+
+/*---------------------------------------------------------------------
+ * Function:   Mpi_world_size
+ * Purpose:    Bytes in this process's block, with its ghost border
+ */
+static size_t Mpi_world_size(int m, int n) {
+   return Halo_world_size(mpi_rows, mpi_cols);
+}  /* Mpi_world_size */
+
+/*---------------------------------------------------------------------
+ * Function:   Mpi_store_row
+ * Purpose:    On process 0:  send each piece of row i of generation
+ *             0 to the process that owns it, keeping its own piece
+ *             in w
+ */
+static void Mpi_store_row(void* w, int m, int n, int i, const char row[]) {
+   int pi = Block_owner(m, r, i);
+   int pj, col0, col1;
+
+   for (pj = 0; pj < s; pj++) {
+      Block_range(n, s, pj, &col0, &col1);
+      if (pi*s + pj == mpi_rank)
+         Halo_store_cells(w, mpi_rows, mpi_cols, i - mpi_row0, 0,
+               col1 - col0, (const unsigned char*) row + col0);
+      else
+         MPI_Send(row + col0, col1 - col0, MPI_CHAR, pi*s + pj,
+               MPI_ROW_TAG, MPI_COMM_WORLD);
+   }
+}  /* Mpi_store_row */
+
+/*---------------------------------------------------------------------
+ * Function:   Mpi_load_row
+ * Purpose:    On process 0:  put row i together from the pieces of
+ *             the processes that own it
+ */
+static void Mpi_load_row(const void* w, int m, int n, int i, char row[]) {
+   int pi = Block_owner(m, r, i);
+   int pj, col0, col1;
+
+   for (pj = 0; pj < s; pj++) {
+      Block_range(n, s, pj, &col0, &col1);
+      if (pi*s + pj == mpi_rank)
+         Halo_load_cells(w, mpi_rows, mpi_cols, i - mpi_row0, 0,
+               col1 - col0, (unsigned char*) row + col0);
+      else
+         MPI_Recv(row + col0, col1 - col0, MPI_CHAR, pi*s + pj,
+               MPI_ROW_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+   }
+}  /* Mpi_load_row */
+
+static const Engine mpi_engine = {
+   "mpi", Dense_units, Mpi_world_size, Mpi_store_row, Mpi_load_row,
+   NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL, NULL
+};
+
+/*---------------------------------------------------------------------
+ * Function:   Mpi_block_rows
+ * Purpose:    On the processes other than 0:  receive (send = 0) the
+ *             rows of this block of generation 0 from process 0, or
+ *             send (send = 1) them to process 0 to be printed, in
+ *             the order process 0 handles them
+ */
+static void Mpi_block_rows(void* w, int send) {
+   size_t stride = mpi_cols + 2;
+   unsigned char* row;
+   int i;
+
+   for (i = 0; i < mpi_rows; i++) {
+      row = (unsigned char*) w + (i+1)*stride + 1;
+      if (send)
+         MPI_Send(row, mpi_cols, MPI_UNSIGNED_CHAR, 0, MPI_ROW_TAG,
+               MPI_COMM_WORLD);
+      else
+         MPI_Recv(row, mpi_cols, MPI_UNSIGNED_CHAR, 0, MPI_ROW_TAG,
+               MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+   }
+}  /* Mpi_block_rows */
+
+/*---------------------------------------------------------------------
+ * Function:   Mpi_gen_block
+ * Purpose:    Generate generation 0 in parallel:  each process makes
+ *             its own block, exactly as Gen_world would
+ * Out arg:    w:  the block
+ * Global var: live_count:  the population of the whole world
+ */
+static void Mpi_gen_block(void* w) {
+   char* row = malloc(mpi_cols);
+   long live = 0;
+   int i, j;
+
+   if (mpi_rank == 0)
+      Get_probability("What's the probability that a cell is alive?");
+   MPI_Bcast(&gen_threshold, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+   for (i = mpi_row0; i < mpi_row0 + mpi_rows; i++) {
+      Gen_cells(seed, gen_threshold, i, mpi_col0, mpi_col0 + mpi_cols, row);
+      Paste_patterns(m, n, i, mpi_col0, mpi_col0 + mpi_cols, row);
+      for (j = 0; j < mpi_cols; j++)
+         if (row[j] == LIVE) live++;
+      Halo_store_cells(w, mpi_rows, mpi_cols, i - mpi_row0, 0, mpi_cols,
+            (unsigned char*) row);
+   }
+   MPI_Reduce(&live, &live_count, 1, MPI_LONG, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   if (mpi_rank == 0) printf("\n");
+   free(row);
+}  /* Mpi_gen_block */
+
+/*---------------------------------------------------------------------
+ * Function:   Mpi_print
+ * Purpose:    Print or checkpoint generation gen:  process 0 writes
+ *             it, the others send it their rows
+ */
+static void Mpi_print(void* w, long gen, long live) {
+   if (Want_print(gen, gen == max_gens)) {
+      if (mpi_rank == 0) {
+         Write_frame(w, gen, live);
+         fflush(stdout);
+      } else {
+         Mpi_block_rows(w, 1);
+      }
+   }
+   if (Want_checkpoint(gen)) {
+      if (mpi_rank == 0)
+         Write_checkpoint(w, gen, live);
+      else
+         Mpi_block_rows(w, 1);
+   }
+}  /* Mpi_print */
+
+/*---------------------------------------------------------------------
+ * Function:   Mpi_exchange
+ * Purpose:    Start filling the ghost border of block w from the
+ *             neighboring processes
+ * In arg:     w
+ * Out arg:    reqs:  16 requests to wait for
+ * In arg:     column:  MPI type of one column of the block
+ *
+ * Note:       On a grid 1 or 2 processes wide a process is its own
+ *             neighbor, or the same neighbor twice.  The tags keep
+ *             the messages apart.
+ */
+static void Mpi_exchange(unsigned char* w, MPI_Request reqs[],
+      MPI_Datatype column) {
+   int h = mpi_rows, wd = mpi_cols;
+   size_t stride = wd + 2;
+   int pi = mpi_rank / s, pj = mpi_rank % s;
+   int d, di, dj, nbr, count;
+   size_t send, recv;
+   MPI_Datatype type;
+
+   for (d = 0; d < 8; d++) {
+      di = mpi_dirs[d][0];
+      dj = mpi_dirs[d][1];
+      nbr = ((pi + di + r) % r)*s + (pj + dj + s) % s;
+      /* The first cell sent, and the first ghost cell received */
+      send = (di < 0 ? 1 : h)*stride + (dj < 0 ? 1 : wd);
+      recv = (di < 0 ? 0 : h + 1)*stride + (dj < 0 ? 0 : wd + 1);
+      if (di == 0) {
+         send = stride + (dj < 0 ? 1 : wd);
+         recv = stride + (dj < 0 ? 0 : wd + 1);
+      } else if (dj == 0) {
+         send = (di < 0 ? 1 : h)*stride + 1;
+         recv = (di < 0 ? 0 : h + 1)*stride + 1;
+      }
+      type = di == 0 ? column : MPI_UNSIGNED_CHAR;
+      count = di != 0 && dj == 0 ? wd : 1;
+      MPI_Irecv(w + recv, count, type, nbr, 7 - d, MPI_COMM_WORLD,
+            &reqs[d]);
+      MPI_Isend(w + send, count, type, nbr, d, MPI_COMM_WORLD,
+            &reqs[8 + d]);
+   }
+}  /* Mpi_exchange */
+
+/*---------------------------------------------------------------------
+ * Function:   Mpi_part
+ * Purpose:    Compute a part of the block, if it isn't empty
+ */
+static long Mpi_part(const void* cur, void* next, int row0, int row1,
+      int col0, int col1) {
+   if (row0 >= row1 || col0 >= col1) return 0;
+   return mpi_update(cur, next, mpi_rows, mpi_cols, row0, row1,
+         col0, col1, rule);
+}  /* Mpi_part */
+
+/*---------------------------------------------------------------------
+ * Function:   Mpi_main
+ * Purpose:    Run the whole simulation as one of r*c MPI processes
+ * In args:    argc_p, argv_p:  for MPI_Init
+ *             ig:  'i' or 'g'
+ * Ret val:    Exit status
+ * Global var: mpi_rank, mpi_row0, mpi_col0, mpi_rows, mpi_cols,
+ *             mpi_update, engine, curr_gen, live_count
+ */
+int Mpi_main(int* argc_p, char** argv_p[], char ig) {
+   int size, row1, col1, h, wd;
+   unsigned char *cur, *next, *tmp;
+   MPI_Request reqs[16];
+   MPI_Datatype column;
+   long live;
+
+   MPI_Init(argc_p, argv_p);
+   MPI_Comm_size(MPI_COMM_WORLD, &size);
+   MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+   if (size != r*s || m < r || n < s) {
+      if (mpi_rank == 0)
+         fprintf(stderr, "--mpi needs r*c = %d processes, and at least "
+               "r rows and c columns\n", r*s);
+      MPI_Finalize();
+      return 1;
+   }
+   Block_range(m, r, mpi_rank / s, &mpi_row0, &row1);
+   Block_range(n, s, mpi_rank % s, &mpi_col0, &col1);
+   h = mpi_rows = row1 - mpi_row0;
+   wd = mpi_cols = col1 - mpi_col0;
+   mpi_update = Select_kernel(Find_engine("halo"), kernel_name);
+   if (mpi_update == NULL) mpi_update = Halo_update;
+   engine = &mpi_engine;
+   MPI_Type_vector(h, 1, wd + 2, MPI_UNSIGNED_CHAR, &column);
+   MPI_Type_commit(&column);
+
+   cur = World_alloc(Halo_world_size(h, wd));
+   next = World_alloc(Halo_world_size(h, wd));
+   if (ig == 'g' && restore_file == NULL) {
+      Mpi_gen_block(cur);
+   } else if (mpi_rank == 0) {
+      Make_world(ig, cur, NULL);
+      printf("\n");
+   } else {
+      Mpi_block_rows(cur, 0);
+   }
+   MPI_Bcast(&live_count, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+   MPI_Bcast(&curr_gen, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+   first_gen = curr_gen;
+   if (mpi_rank == 0) Frames_start();
+   if (Want_output(curr_gen, curr_gen == max_gens))
+      Mpi_print(cur, curr_gen, live_count);
+
+   while (curr_gen < max_gens) {
+      Mpi_exchange(cur, reqs, column);
+      live = Mpi_part(cur, next, 1, h - 1, 1, wd - 1);
+      MPI_Waitall(16, reqs, MPI_STATUSES_IGNORE);
+      live += Mpi_part(cur, next, 0, 1, 0, wd);
+      live += Mpi_part(cur, next, h > 1 ? h - 1 : 1, h, 0, wd);
+      live += Mpi_part(cur, next, 1, h - 1, 0, 1);
+      live += Mpi_part(cur, next, 1, h - 1, wd > 1 ? wd - 1 : 1, wd);
+      MPI_Allreduce(&live, &live_count, 1, MPI_LONG, MPI_SUM,
+            MPI_COMM_WORLD);
+
+      tmp = cur;
+      cur = next;
+      next = tmp;
+      curr_gen++;
+      if (live_count == 0) break;
+      if (Want_output(curr_gen, curr_gen == max_gens))
+         Mpi_print(cur, curr_gen, live_count);
+   }
+   if (mpi_rank == 0) {
+      Frames_finish();
+      if (curr_gen < max_gens) printf("There are no more live cells\n");
+   }
+
+   MPI_Type_free(&column);
+   World_free(cur, Halo_world_size(h, wd));
+   World_free(next, Halo_world_size(h, wd));
+   MPI_Finalize();
+   return 0;
+}  /* Mpi_main */
+#endif
@@ -0,0 +1,393 @@
+/* File:     pth_life_gpu.cu
+ * Purpose:  GPU engines for pth_life.c:  the world lives on the
+ *           device, in two buffers, and is only copied back to the
+ *           host when a generation is printed.
+ *
+ *              gpu         one byte per cell.  Each block of threads
+ *                          loads a tile of the world, with a one cell
+ *                          border, into shared memory, and computes
+ *                          the tile from there.
+ *              gpu-packed  one bit per cell, in the packed engine's
+ *                          layout.  Each thread computes a 64-bit
+ *                          word with the bit-sliced adder.
+ *
+ * Compile:  nvcc -O2 -c pth_life_gpu.cu
+ *           gcc -g -Wall -O2 -DUSE_GPU -o pth_life pth_life.c \
+ *              pth_life_gpu.o -lpthread -lcudart -lstdc++
+ *           For AMD GPUs:  hipcc -O2 -DUSE_HIP -c -x hip pth_life_gpu.cu,
+ *           and link with -lamdhip64 instead of -lcudart.
+ *
+ * Notes:
+ * 1.  The world is a torus, as in pth_life.c.  The byte kernel
+ *     wraps the indices of the border cells it loads; the packed
+ *     kernel handles the seam between the last and first words as
+ *     Packed_shift does.
+ * 2.  Gpu_step runs a batch of generations without coming back to
+ *     the host.  The kernels add up the population of each
+ *     generation on the device, and the counts for the whole batch
+ *     are copied back at the end of it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef USE_HIP
+#  include <hip/hip_runtime.h>
+#  define gpuError_t             hipError_t
+#  define gpuSuccess             hipSuccess
+#  define gpuGetErrorString      hipGetErrorString
+#  define gpuGetLastError        hipGetLastError
+#  define gpuMalloc              hipMalloc
+#  define gpuFree                hipFree
+#  define gpuMemcpy              hipMemcpy
+#  define gpuMemcpy2D            hipMemcpy2D
+#  define gpuMemset              hipMemset
+#  define gpuMemcpyHostToDevice  hipMemcpyHostToDevice
+#  define gpuMemcpyDeviceToHost  hipMemcpyDeviceToHost
+#else
+#  include <cuda_runtime.h>
+#  define gpuError_t             cudaError_t
+#  define gpuSuccess             cudaSuccess
+#  define gpuGetErrorString      cudaGetErrorString
+#  define gpuGetLastError        cudaGetLastError
+#  define gpuMalloc              cudaMalloc
+#  define gpuFree                cudaFree
+#  define gpuMemcpy              cudaMemcpy
+#  define gpuMemcpy2D            cudaMemcpy2D
+#  define gpuMemset              cudaMemset
+#  define gpuMemcpyHostToDevice  cudaMemcpyHostToDevice
+#  define gpuMemcpyDeviceToHost  cudaMemcpyDeviceToHost
+#endif
+
+#define TILE_X 32           /* threads per block of the byte kernel */
+#define TILE_Y 8
+#define WORD_THREADS 256    /* threads per block of the packed kernel */
+#define MAX_GRID 65535      /* blocks in grid y (and a cap on x) */
+
+/* Rules as in pth_life.c:  bit k is birth with k neighbors, bit 9+k
+   survival with k */
+#define RULE_CONWAY 0x01808
+#define RULE_NEXT(r, alive, count) (((r) >> ((count) + 9*(alive))) & 1)
+
+/* Stop on any error from the GPU runtime */
+#define GPU_CHECK(call) do {                                          \
+   gpuError_t err_ = (call);                                          \
+   if (err_ != gpuSuccess) {                                          \
+      fprintf(stderr, "GPU error at %s:%d: %s\n", __FILE__, __LINE__, \
+            gpuGetErrorString(err_));                                 \
+      exit(1);                                                        \
+   }                                                                  \
+} while (0)
+
+struct Gpu_world {
+   int    m, n;
+   int    packed;
+   int    words;               /* per row, packed only */
+   size_t size;                /* bytes in one buffer */
+   void   *cur, *next;         /* device buffers */
+   unsigned long long* pop;    /* device population of each
+                                  generation of a batch */
+   unsigned long long* host_pop;  /* and its copy on the host */
+   int    max_batch;
+   unsigned rule;
+};
+
+/*---------------------------------------------------------------------
+ * Function:   Byte_kernel
+ * Purpose:    Compute the next generation of a byte-per-cell world.
+ *             A block computes TILE_Y x TILE_X tiles, walking down
+ *             the world if there are more tile rows than blocks.
+ * In args:    cur:  the m x n world
+ *             rule:  the rule, unless Conway is true
+ * Out args:   next
+ *             pop:  the population of next is added to *pop
+ */
+template <bool Conway>
+__global__ void Byte_kernel(const unsigned char* cur, unsigned char* next,
+      int m, int n, unsigned rule, unsigned long long* pop) {
+   __shared__ unsigned char tile[TILE_Y + 2][TILE_X + 2];
+   __shared__ unsigned sums[TILE_X*TILE_Y];
+   int tx = threadIdx.x, ty = threadIdx.y;
+   int tid = ty*TILE_X + tx;
+   int tile_rows = (m + TILE_Y - 1)/TILE_Y;
+   int j0 = blockIdx.x*TILE_X;
+   int j = j0 + tx;
+   int by, i0, i, k, gi, gj, count;
+   unsigned live = 0;
+
+   for (by = blockIdx.y; by < tile_rows; by += gridDim.y) {
+      i0 = by*TILE_Y;
+
+      /* The tile and its border, wrapping around the torus.  A world
+         smaller than a tile wraps more than once, so it takes a % */
+      for (k = tid; k < (TILE_Y + 2)*(TILE_X + 2); k += TILE_X*TILE_Y) {
+         gi = i0 + k/(TILE_X + 2) - 1;
+         gj = j0 + k % (TILE_X + 2) - 1;
+         gi = gi < 0 ? gi + m : (gi >= m ? gi % m : gi);
+         gj = gj < 0 ? gj + n : (gj >= n ? gj % n : gj);
+         tile[k/(TILE_X + 2)][k % (TILE_X + 2)] = cur[(size_t) gi*n + gj];
+      }
+      __syncthreads();
+
+      i = i0 + ty;
+      if (i < m && j < n) {
+         count = tile[ty][tx]   + tile[ty][tx+1]   + tile[ty][tx+2]
+               + tile[ty+1][tx]                    + tile[ty+1][tx+2]
+               + tile[ty+2][tx] + tile[ty+2][tx+1] + tile[ty+2][tx+2];
+         count = Conway ? (count == 3) | ((count == 2) & tile[ty+1][tx+1])
+                        : RULE_NEXT(rule, tile[ty+1][tx+1], count);
+         next[(size_t) i*n + j] = count;
+         live += count;
+      }
+      __syncthreads();
+   }
+
+   /* Every thread of the block gets here, so they add up together */
+   sums[tid] = live;
+   __syncthreads();
+   for (k = TILE_X*TILE_Y/2; k > 0; k /= 2) {
+      if (tid < k) sums[tid] += sums[tid + k];
+      __syncthreads();
+   }
+   if (tid == 0) atomicAdd(pop, (unsigned long long) sums[0]);
+}  /* Byte_kernel */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_shift
+ * Purpose:    West and east neighbors of word k of a packed row, as
+ *             in pth_life.c
+ */
+__device__ __forceinline__ void Packed_shift(const uint64_t* row, int k,
+      int last, int tail, uint64_t* west_p, uint64_t* east_p) {
+   uint64_t c = row[k];
+   uint64_t west_in = k > 0 ? row[k-1] >> 63 : (row[last] >> (tail-1)) & 1;
+   uint64_t east_in = k < last ? row[k+1] & 1 : row[0] & 1;
+
+   *west_p = (c << 1) | west_in;
+   *east_p = (c >> 1) | (east_in << (k < last ? 63 : tail-1));
+}  /* Packed_shift */
+
+/* Select b where x is set, and a elsewhere */
+#define SEL(x, a, b) ((a) ^ ((x) & ((a) ^ (b))))
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_rule
+ * Purpose:    The bit-sliced rule of PACKED_RULE in pth_life.c for
+ *             Conway's rule, or of PACKED_ANY_RULE for any other
+ */
+template <bool Conway>
+__device__ __forceinline__ uint64_t Packed_rule(uint64_t nw, uint64_t no,
+      uint64_t ne, uint64_t we, uint64_t c, uint64_t ea, uint64_t sw,
+      uint64_t so, uint64_t se, unsigned rule) {
+   uint64_t s_up = nw ^ no ^ ne;
+   uint64_t c_up = (nw & no) | (ne & (nw ^ no));
+   uint64_t s_dn = sw ^ so ^ se;
+   uint64_t c_dn = (sw & so) | (se & (sw ^ so));
+   uint64_t s_mid = we ^ ea;
+   uint64_t c_mid = we & ea;
+   uint64_t ones = s_up ^ s_dn ^ s_mid;
+   uint64_t carry = (s_up & s_dn) | (s_mid & (s_up ^ s_dn));
+   uint64_t t = c_up ^ c_dn ^ c_mid;
+   uint64_t k1 = (c_up & c_dn) | (c_mid & (c_up ^ c_dn));
+   uint64_t twos = t ^ carry;
+   uint64_t fours = k1 ^ (t & carry);
+   uint64_t eights = k1 & t & carry;
+   uint64_t next[9];
+   int k;
+
+   if (Conway) return twos & ~fours & (ones | c);
+
+   for (k = 0; k <= 8; k++)
+      next[k] = SEL(c, -(uint64_t) RULE_NEXT(rule, 0, k),
+            -(uint64_t) RULE_NEXT(rule, 1, k));
+   next[0] = SEL(ones, next[0], next[1]);
+   next[2] = SEL(ones, next[2], next[3]);
+   next[4] = SEL(ones, next[4], next[5]);
+   next[6] = SEL(ones, next[6], next[7]);
+   next[0] = SEL(twos, next[0], next[2]);
+   next[4] = SEL(twos, next[4], next[6]);
+   next[0] = SEL(fours, next[0], next[4]);
+   return SEL(eights, next[0], next[8]);
+}  /* Packed_rule */
+
+/*---------------------------------------------------------------------
+ * Function:   Packed_kernel
+ * Purpose:    Compute the next generation of a packed world, one word
+ *             per thread, with a grid-stride loop over the words
+ * In args:    cur:  m rows of words words, n cells each
+ *             rule:  the rule, unless Conway is true
+ * Out args:   next
+ *             pop:  the population of next is added to *pop
+ */
+template <bool Conway>
+__global__ void Packed_kernel(const uint64_t* cur, uint64_t* next,
+      int m, int n, int words, unsigned rule, unsigned long long* pop) {
+   __shared__ unsigned long long sums[WORD_THREADS];
+   int last = words - 1;
+   int tail = n - 64*last;
+   uint64_t tail_mask = tail == 64 ? ~(uint64_t) 0
+                                   : ((uint64_t) 1 << tail) - 1;
+   size_t total = (size_t) m*words;
+   size_t idx;
+   const uint64_t *up, *mid, *dn;
+   uint64_t nw, ne, we, ea, sw, se, word;
+   unsigned long long live = 0;
+   int i, k, stride;
+
+   for (idx = (size_t) blockIdx.x*blockDim.x + threadIdx.x; idx < total;
+         idx += (size_t) gridDim.x*blockDim.x) {
+      i = idx / words;
+      k = idx % words;
+      up = cur + (size_t) (i == 0 ? m - 1 : i - 1)*words;
+      mid = cur + (size_t) i*words;
+      dn = cur + (size_t) (i == m - 1 ? 0 : i + 1)*words;
+      Packed_shift(up, k, last, tail, &nw, &ne);
+      Packed_shift(mid, k, last, tail, &we, &ea);
+      Packed_shift(dn, k, last, tail, &sw, &se);
+      word = Packed_rule<Conway>(nw, up[k], ne, we, mid[k], ea,
+            sw, dn[k], se, rule);
+      if (k == last) word &= tail_mask;
+      next[idx] = word;
+      live += __popcll(word);
+   }
+
+   sums[threadIdx.x] = live;
+   __syncthreads();
+   for (stride = WORD_THREADS/2; stride > 0; stride /= 2) {
+      if ((int) threadIdx.x < stride)
+         sums[threadIdx.x] += sums[threadIdx.x + stride];
+      __syncthreads();
+   }
+   if (threadIdx.x == 0) atomicAdd(pop, sums[0]);
+}  /* Packed_kernel */
+
+extern "C" {
+
+/*---------------------------------------------------------------------
+ * Function:   Gpu_create
+ * Purpose:    Allocate the device buffers for an m x n world
+ * In args:    m, n
+ *             packed:  1 for the packed layout, 0 for bytes
+ *             max_batch:  most generations per Gpu_step
+ *             rule:  as in pth_life.c
+ * Ret val:    The device world, or NULL if there's no host memory for
+ *             it (errors of the GPU runtime stop the program)
+ */
+struct Gpu_world* Gpu_create(int m, int n, int packed, int max_batch,
+      unsigned rule) {
+   struct Gpu_world* g = (struct Gpu_world*) malloc(sizeof(*g));
+
+   if (g == NULL) return NULL;
+   g->host_pop = (unsigned long long*) malloc(
+         max_batch*sizeof(unsigned long long));
+   if (g->host_pop == NULL) {
+      free(g);
+      return NULL;
+   }
+   g->m = m;
+   g->n = n;
+   g->packed = packed;
+   g->words = (n + 63)/64;
+   g->size = packed ? (size_t) m*g->words*sizeof(uint64_t) : (size_t) m*n;
+   g->max_batch = max_batch;
+   g->rule = rule;
+   GPU_CHECK(gpuMalloc(&g->cur, g->size));
+   GPU_CHECK(gpuMalloc(&g->next, g->size));
+   GPU_CHECK(gpuMalloc((void**) &g->pop,
+            max_batch*sizeof(unsigned long long)));
+
+   return g;
+}  /* Gpu_create */
+
+/*---------------------------------------------------------------------
+ * Function:   Gpu_upload
+ * Purpose:    Copy a host world to the device.  A byte world comes
+ *             from a halo world of pth_life.c, without its border;
+ *             a packed world is copied as it is.
+ */
+void Gpu_upload(struct Gpu_world* g, const void* w) {
+   if (g->packed)
+      GPU_CHECK(gpuMemcpy(g->cur, w, g->size, gpuMemcpyHostToDevice));
+   else
+      GPU_CHECK(gpuMemcpy2D(g->cur, g->n,
+               (const unsigned char*) w + (g->n + 2) + 1, g->n + 2,
+               g->n, g->m, gpuMemcpyHostToDevice));
+}  /* Gpu_upload */
+
+/*---------------------------------------------------------------------
+ * Function:   Gpu_download
+ * Purpose:    Copy the current generation back into a host world
+ *             laid out as for Gpu_upload.  The border of a halo
+ *             world is not written.
+ */
+void Gpu_download(const struct Gpu_world* g, void* w) {
+   if (g->packed)
+      GPU_CHECK(gpuMemcpy(w, g->cur, g->size, gpuMemcpyDeviceToHost));
+   else
+      GPU_CHECK(gpuMemcpy2D((unsigned char*) w + (g->n + 2) + 1,
+               g->n + 2, g->cur, g->n, g->n, g->m,
+               gpuMemcpyDeviceToHost));
+}  /* Gpu_download */
+
+/*---------------------------------------------------------------------
+ * Function:   Gpu_step
+ * Purpose:    Advance the device world gens generations
+ * In args:    g, gens:  1 <= gens <= max_batch
+ * Out arg:    live:  live[k] is the population k+1 generations on
+ */
+void Gpu_step(struct Gpu_world* g, int gens, long live[]) {
+   dim3 threads(TILE_X, TILE_Y);
+   dim3 blocks((g->n + TILE_X - 1)/TILE_X,
+         (g->m + TILE_Y - 1)/TILE_Y < MAX_GRID
+            ? (g->m + TILE_Y - 1)/TILE_Y : MAX_GRID);
+   size_t words = (size_t) g->m*g->words;
+   unsigned word_blocks = (words + WORD_THREADS - 1)/WORD_THREADS
+      < 64*MAX_GRID ? (words + WORD_THREADS - 1)/WORD_THREADS : 64*MAX_GRID;
+   void* tmp;
+   int k;
+
+   GPU_CHECK(gpuMemset(g->pop, 0, gens*sizeof(unsigned long long)));
+   for (k = 0; k < gens; k++) {
+      if (g->packed && g->rule == RULE_CONWAY)
+         Packed_kernel<true><<<word_blocks, WORD_THREADS>>>(
+               (const uint64_t*) g->cur, (uint64_t*) g->next,
+               g->m, g->n, g->words, g->rule, g->pop + k);
+      else if (g->packed)
+         Packed_kernel<false><<<word_blocks, WORD_THREADS>>>(
+               (const uint64_t*) g->cur, (uint64_t*) g->next,
+               g->m, g->n, g->words, g->rule, g->pop + k);
+      else if (g->rule == RULE_CONWAY)
+         Byte_kernel<true><<<blocks, threads>>>(
+               (const unsigned char*) g->cur, (unsigned char*) g->next,
+               g->m, g->n, g->rule, g->pop + k);
+      else
+         Byte_kernel<false><<<blocks, threads>>>(
+               (const unsigned char*) g->cur, (unsigned char*) g->next,
+               g->m, g->n, g->rule, g->pop + k);
+      GPU_CHECK(gpuGetLastError());
+      tmp = g->cur;
+      g->cur = g->next;
+      g->next = tmp;
+   }
+
+   /* Waits for the kernels */
+   GPU_CHECK(gpuMemcpy(g->host_pop, g->pop,
+            gens*sizeof(unsigned long long), gpuMemcpyDeviceToHost));
+   for (k = 0; k < gens; k++)
+      live[k] = (long) g->host_pop[k];
+}  /* Gpu_step */
+
+/*---------------------------------------------------------------------
+ * Function:   Gpu_destroy
+ * Purpose:    Free the device world
+ */
+void Gpu_destroy(struct Gpu_world* g) {
+   GPU_CHECK(gpuFree(g->cur));
+   GPU_CHECK(gpuFree(g->next));
+   GPU_CHECK(gpuFree(g->pop));
+   free(g->host_pop);
+   free(g);
+}  /* Gpu_destroy */
+
+}  /* extern "C" */